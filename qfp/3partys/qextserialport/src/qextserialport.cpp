@@ -534,6 +534,39 @@ qint64 QextSerialPort::bytesAvailable() const
     return 0;
 }
 
+/*! \reimp
+    Blocks until new data is available for reading or until \a msecs milliseconds have
+    passed. A negative \a msecs waits forever. Returns true if data is available, false
+    on timeout, error or if the port is not open.
+
+    This does not need an event loop, so it can be used from a worker thread that
+    opened the port in QextSerialPort::Polling mode.
+*/
+bool QextSerialPort::waitForReadyRead(int msecs)
+{
+    Q_D(QextSerialPort);
+    {
+        QReadLocker locker(&d->lock);
+        if (!isOpen())
+            return false;
+        if (!d->readBuffer.isEmpty())
+            return true;
+    }
+    // The lock is not held while waiting so writes from other threads are not blocked.
+    return d->waitForReadyRead_sys(msecs);
+}
+
+/*!
+    Makes a waitForReadyRead() blocked in another thread return false right away.
+    If no thread is waiting, the next call returns at once instead.
+    This function is thread-safe.
+*/
+void QextSerialPort::abortWait()
+{
+    Q_D(QextSerialPort);
+    d->abortWait_sys();
+}
+
 /*! \reimp
 
 */
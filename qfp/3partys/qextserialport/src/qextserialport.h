@@ -200,6 +200,8 @@ public:
     qint64 bytesAvailable() const;
     bool canReadLine() const;
     QByteArray readAll();
+    bool waitForReadyRead(int msecs);
+    void abortWait();
 
     ulong lastError() const;
 
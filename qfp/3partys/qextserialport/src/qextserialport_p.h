@@ -45,6 +45,7 @@
 
 #include "qextserialport.h"
 #include <QtCore/QReadWriteLock>
+#include <QtCore/QAtomicInt>
 #ifdef Q_OS_UNIX
 #  include <termios.h>
 #elif (defined Q_OS_WIN)
@@ -202,6 +203,7 @@ public:
     // platform specific members
 #ifdef Q_OS_UNIX
     int fd;
+    int abortPipe[2];
     QSocketNotifier *readNotifier;
     struct termios Posix_CommConfig;
     struct termios old_termios;
@@ -215,6 +217,7 @@ public:
     QList<OVERLAPPED*> pendingWrites;
     QReadWriteLock* bytesToWriteLock;
     qint64 _bytesToWrite;
+    QAtomicInt waitAborted;
 #endif
 
     /*fill PortSettings*/
@@ -240,6 +243,8 @@ public:
     bool flush_sys();
     ulong lineStatus_sys();
     qint64 bytesAvailable_sys() const;
+    bool waitForReadyRead_sys(int msecs);
+    void abortWait_sys();
 
 #ifdef Q_OS_WIN
     void _q_onWinEvent(HANDLE h);
@@ -38,6 +38,7 @@
 #include <sys/time.h>
 #include <sys/ioctl.h>
 #include <sys/select.h>
+#include <poll.h>
 #include <QtCore/QMutexLocker>
 #include <QtCore/QDebug>
 #include <QtCore/QSocketNotifier>
@@ -46,6 +47,16 @@ void QextSerialPortPrivate::platformSpecificInit()
 {
     fd = 0;
     readNotifier = 0;
+
+    // self-pipe used by abortWait_sys() to wake up poll()
+    if (::pipe(abortPipe) == -1) {
+        abortPipe[0] = abortPipe[1] = -1;
+    } else {
+        for (int i = 0; i < 2; ++i) {
+            ::fcntl(abortPipe[i], F_SETFL, ::fcntl(abortPipe[i], F_GETFL) | O_NONBLOCK);
+            ::fcntl(abortPipe[i], F_SETFD, FD_CLOEXEC);
+        }
+    }
 }
 
 /*!
@@ -53,6 +64,10 @@ void QextSerialPortPrivate::platformSpecificInit()
 */
 void QextSerialPortPrivate::platformSpecificDestruct()
 {
+    if (abortPipe[0] != -1) {
+        ::close(abortPipe[0]);
+        ::close(abortPipe[1]);
+    }
 }
 
 static QString fullPortName(const QString &name)
@@ -133,6 +148,53 @@ qint64 QextSerialPortPrivate::bytesAvailable_sys() const
     return bytesQueued;
 }
 
+/*!
+    Waits with poll() until the port is readable or \a msecs milliseconds have passed.
+    Used internally.
+*/
+bool QextSerialPortPrivate::waitForReadyRead_sys(int msecs)
+{
+    struct pollfd pfd[2];
+    pfd[0].fd = fd;
+    pfd[0].events = POLLIN;
+    pfd[0].revents = 0;
+    pfd[1].fd = abortPipe[0];
+    pfd[1].events = POLLIN;
+    pfd[1].revents = 0;
+
+    int ret;
+    do {
+        ret = ::poll(pfd, abortPipe[0] != -1 ? 2 : 1, msecs);
+    } while (ret == -1 && errno == EINTR);
+
+    if (ret == -1) {
+        translateError(errno);
+        return false;
+    }
+
+    if (pfd[1].revents & POLLIN) {
+        char buf[16];
+        while (::read(abortPipe[0], buf, sizeof(buf)) > 0)
+            ;
+        return false;
+    }
+
+    return ret > 0 && (pfd[0].revents & POLLIN);
+}
+
+/*!
+    Wakes up waitForReadyRead_sys(). Used internally.
+*/
+void QextSerialPortPrivate::abortWait_sys()
+{
+    if (abortPipe[1] == -1)
+        return;
+    // a full pipe already has a wake up pending
+    const char c = 0;
+    ssize_t ret = ::write(abortPipe[1], &c, 1);
+    Q_UNUSED(ret);
+}
+
 /*!
     Translates a system-specific error code to a QextSerialPort error code.  Used internally.
 */
@@ -37,6 +37,7 @@
 #include <QtCore/QDebug>
 #include <QtCore/QRegExp>
 #include <QtCore/QMetaType>
+#include <QtCore/QTime>
 #if QT_VERSION >= QT_VERSION_CHECK(5, 0, 0)
 #  include <QtCore/QWinEventNotifier>
 #else
@@ -156,6 +157,34 @@ qint64 QextSerialPortPrivate::bytesAvailable_sys() const
     return (qint64)-1;
 }
 
+/*
+    Waits until the driver reports queued input or \a msecs milliseconds have passed.
+    Used internally.
+*/
+bool QextSerialPortPrivate::waitForReadyRead_sys(int msecs)
+{
+    QTime timer;
+    timer.start();
+    forever {
+        const qint64 bytes = bytesAvailable_sys();
+        if (bytes > 0)
+            return true;
+        if (bytes == -1 || (msecs >= 0 && timer.elapsed() >= msecs))
+            return false;
+        if (waitAborted.fetchAndStoreOrdered(0))
+            return false;
+        ::Sleep(1);
+    }
+}
+
+/*
+    Wakes up waitForReadyRead_sys(). Used internally.
+*/
+void QextSerialPortPrivate::abortWait_sys()
+{
+    waitAborted.fetchAndStoreOrdered(1);
+}
+
 /*
     Translates a system-specific error code to a QextSerialPort error code.  Used internally.
 */
@@ -0,0 +1,214 @@
+/*
+*
+* Copyright (C)2018, Samuel Isuani <sisuani@gmail.com>
+* All rights reserved.
+*
+* Redistribution and use in source and binary forms, with or without
+* modification, are permitted provided that the following conditions
+* are met:
+*
+* Redistributions of source code must retain the above copyright notice,
+* this list of conditions and the following disclaimer.
+*
+* Redistributions in binary form must reproduce the above copyright
+* notice, this list of conditions and the following disclaimer in the
+* documentation and/or other materials provided with the distribution.
+*
+* Neither the name of the project's author nor the names of its
+* contributors may be used to endorse or promote products derived from
+* this software without specific prior written permission.
+*
+* THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+* "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+* LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+* FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+* HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+* SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED
+* TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+* PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+* LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+* NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+* SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*
+*/
+
+
+#include "commandjournal.h"
+#include "logger.h"
+
+#include <string.h>
+
+#if defined (Q_OS_UNIX)
+#include <sys/mman.h>
+#elif defined (Q_OS_WIN32)
+#include <windows.h>
+#endif
+
+// file header: magic and the epoch of the records that are current,
+// end() bumps it so stale records further on no longer match
+static const char MAGIC[4] = { 'Q', 'F', 'P', 'J' };
+static const int HEADER_SIZE = 16;
+
+CommandJournal::CommandJournal(const QString &path, const int size)
+    : m_file(path)
+    , m_map(0)
+    , m_size(size)
+    , m_offset(HEADER_SIZE)
+    , m_epoch(1)
+    , m_full(false)
+{
+    if (!m_file.open(QIODevice::ReadWrite))
+        return;
+
+    if (m_file.size() < m_size && !m_file.resize(m_size))
+        return;
+
+    m_map = m_file.map(0, m_size);
+    if (!m_map)
+        return;
+
+    if (memcmp(m_map, MAGIC, sizeof(MAGIC)) != 0) {
+        memset(m_map, 0, HEADER_SIZE);
+        memcpy(m_map, MAGIC, sizeof(MAGIC));
+        memcpy(m_map + sizeof(MAGIC), &m_epoch, sizeof(m_epoch));
+        sync();
+    } else {
+        memcpy(&m_epoch, m_map + sizeof(MAGIC), sizeof(m_epoch));
+    }
+
+    Record record;
+    int offset;
+    while ((offset = next(m_offset, &record)) > 0) {
+        m_offset = offset;
+        if (record.type == Overflow)
+            m_full = true;
+    }
+
+#ifdef DEBUG
+    if (inDocument())
+        log << QString("CommandJournal() -> document left open in %1").arg(path);
+#endif
+}
+
+CommandJournal::~CommandJournal()
+{
+    if (m_map)
+        m_file.unmap(m_map);
+}
+
+bool CommandJournal::isOpen() const
+{
+    return m_map != 0;
+}
+
+bool CommandJournal::inDocument() const
+{
+    return m_offset > HEADER_SIZE;
+}
+
+QList<CommandJournal::Record> CommandJournal::pending() const
+{
+    QList<Record> records;
+    if (!m_map)
+        return records;
+
+    Record record;
+    int offset = HEADER_SIZE;
+    while ((offset = next(offset, &record)) > 0)
+        records.append(record);
+    return records;
+}
+
+void CommandJournal::begin(const int cmd)
+{
+    // a document nobody closed is superseded by this one
+    if (inDocument())
+        end();
+
+    append(Begin, cmd);
+    sync();
+}
+
+void CommandJournal::queued(const int cmd, const QByteArray &frame)
+{
+    if (inDocument())
+        append(Queued, cmd, frame);
+}
+
+void CommandJournal::acked(const int cmd, const bool ok)
+{
+    if (inDocument())
+        append(ok ? Acked : Failed, cmd);
+}
+
+void CommandJournal::end()
+{
+    if (!m_map)
+        return;
+
+    m_epoch++;
+    memcpy(m_map + sizeof(MAGIC), &m_epoch, sizeof(m_epoch));
+    m_offset = HEADER_SIZE;
+    m_full = false;
+    sync();
+}
+
+bool CommandJournal::append(const int type, const int cmd, const QByteArray &data)
+{
+    if (!m_map || m_full)
+        return false;
+
+    const int size = (sizeof(RecordHeader) + data.size() + 3) & ~3;
+    // always leave room for the Overflow record
+    if (type != Overflow && m_offset + size + int(sizeof(RecordHeader)) > m_size) {
+#ifdef DEBUG
+        log << QString("CommandJournal::append() -> full at cmd 0x%1").arg(cmd, 0, 16);
+#endif
+        append(Overflow, cmd);
+        m_full = true;
+        return false;
+    }
+
+    RecordHeader h;
+    h.epoch = m_epoch;
+    h.type = type;
+    h.cmd = cmd;
+    h.size = data.size();
+    h.checksum = qChecksum(data.constData(), data.size()) ^ h.type ^ h.cmd;
+    h.reserved = 0;
+
+    // the header goes last, a record cut short by a crash does not match
+    memcpy(m_map + m_offset + sizeof(h), data.constData(), data.size());
+    memcpy(m_map + m_offset, &h, sizeof(h));
+    m_offset += size;
+    return true;
+}
+
+int CommandJournal::next(const int offset, Record *record) const
+{
+    RecordHeader h;
+    if (offset + int(sizeof(h)) > m_size)
+        return 0;
+
+    memcpy(&h, m_map + offset, sizeof(h));
+    if (h.epoch != m_epoch || !h.type || offset + sizeof(h) + h.size > quint32(m_size))
+        return 0;
+
+    const char *data = reinterpret_cast<const char *>(m_map + offset + sizeof(h));
+    if ((qChecksum(data, h.size) ^ h.type ^ h.cmd) != h.checksum)
+        return 0;
+
+    record->type = h.type;
+    record->cmd = h.cmd;
+    record->data = QByteArray(data, h.size);
+    return offset + ((sizeof(h) + h.size + 3) & ~3);
+}
+
+void CommandJournal::sync()
+{
+#if defined (Q_OS_UNIX)
+    msync(m_map, m_size, MS_SYNC);
+#elif defined (Q_OS_WIN32)
+    FlushViewOfFile(m_map, m_size);
+#endif
+}
@@ -0,0 +1,100 @@
+/*
+*
+* Copyright (C)2018, Samuel Isuani <sisuani@gmail.com>
+* All rights reserved.
+*
+* Redistribution and use in source and binary forms, with or without
+* modification, are permitted provided that the following conditions
+* are met:
+*
+* Redistributions of source code must retain the above copyright notice,
+* this list of conditions and the following disclaimer.
+*
+* Redistributions in binary form must reproduce the above copyright
+* notice, this list of conditions and the following disclaimer in the
+* documentation and/or other materials provided with the distribution.
+*
+* Neither the name of the project's author nor the names of its
+* contributors may be used to endorse or promote products derived from
+* this software without specific prior written permission.
+*
+* THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+* "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+* LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+* FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+* HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+* SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED
+* TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+* PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+* LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+* NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+* SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*
+*/
+
+
+#ifndef COMMANDJOURNAL_H
+#define COMMANDJOURNAL_H
+
+#include <QByteArray>
+#include <QFile>
+#include <QList>
+
+// Write-ahead log of the document being printed, kept in a memory mapped
+// file that survives a crash of the process. Records go straight to the
+// map; the file is synced when a document begins and ends. Once the
+// document is closed the journal starts over, so it only ever holds one.
+class CommandJournal
+{
+
+public:
+    enum RecordType {
+        Begin = 1,
+        Queued,     // frame written to the printer, data holds its bytes
+        Acked,      // answered
+        Failed,     // answered with an error
+        Overflow    // the journal is full, the rest of the document is missing
+    };
+
+    struct Record {
+        int type;
+        int cmd;
+        QByteArray data;
+    };
+
+    explicit CommandJournal(const QString &path, const int size = 256 * 1024);
+    ~CommandJournal();
+
+    bool isOpen() const;
+    bool inDocument() const;
+    // the open document, as left by a previous run or by this one
+    QList<Record> pending() const;
+
+    void begin(const int cmd);
+    void queued(const int cmd, const QByteArray &frame);
+    void acked(const int cmd, const bool ok);
+    void end();
+
+private:
+    struct RecordHeader {
+        quint32 epoch;
+        quint16 type;
+        quint16 cmd;
+        quint32 size;
+        quint16 checksum;
+        quint16 reserved;
+    };
+
+    bool append(const int type, const int cmd, const QByteArray &data = QByteArray());
+    int next(const int offset, Record *record) const;
+    void sync();
+
+    QFile m_file;
+    uchar *m_map;
+    int m_size;
+    int m_offset;
+    quint32 m_epoch;
+    bool m_full;
+};
+
+#endif // COMMANDJOURNAL_H
@@ -0,0 +1,454 @@
+/*
+*
+* Copyright (C)2018, Samuel Isuani <sisuani@gmail.com>
+* All rights reserved.
+*
+* Redistribution and use in source and binary forms, with or without
+* modification, are permitted provided that the following conditions
+* are met:
+*
+* Redistributions of source code must retain the above copyright notice,
+* this list of conditions and the following disclaimer.
+*
+* Redistributions in binary form must reproduce the above copyright
+* notice, this list of conditions and the following disclaimer in the
+* documentation and/or other materials provided with the distribution.
+*
+* Neither the name of the project's author nor the names of its
+* contributors may be used to endorse or promote products derived from
+* this software without specific prior written permission.
+*
+* THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+* "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+* LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+* FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+* HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+* SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED
+* TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+* PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+* LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+* NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+* SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*
+*/
+
+
+#ifndef COMMANDQUEUE_H
+#define COMMANDQUEUE_H
+
+#include <QAtomicInt>
+#include <QList>
+#include <QMutex>
+#include <QMutexLocker>
+#include <QThreadStorage>
+#include <QWaitCondition>
+
+#include <limits.h>
+
+#include "fiscalreply.h"
+
+// Priority classes of the driver queue. A batch is never split: the worker
+// only switches lanes once the whole batch it is sending went out.
+enum CommandLane {
+    NormalLane = 0,
+    ControlLane,    // drawer, status: ahead of normal commands between documents
+    UrgentLane,     // cancel: ahead of everything at the next batch boundary
+    LaneCount
+};
+
+// What a command does to the document, for CommandQueue::takeDocument()
+enum DocumentMark {
+    NoMark = 0,
+    OpensDocument,
+    ClosesDocument
+};
+
+// Bounded multi-producer, single-consumer rings, one per lane, between the
+// callers and the driver worker thread. Producers claim slots with a CAS on
+// the tail and publish them through a per slot sequence number, so submitting
+// never takes a lock unless the worker is asleep waiting for work.
+template <typename T>
+class CommandQueue
+{
+
+public:
+    explicit CommandQueue(int capacity = 1024);
+    ~CommandQueue();
+
+    // false when the ring is full or closed, the reply is cancelled then
+    bool push(const T &item, FiscalReply reply = FiscalReply(), CommandLane lane = NormalLane);
+    // the whole batch goes into contiguous slots, never interleaved with other callers
+    bool push(const QList<T> &items, FiscalReply reply = FiscalReply(), CommandLane lane = NormalLane);
+
+    // pushes from the calling thread are held back and queued as one batch,
+    // tied to reply, by the outermost endBatch()
+    void beginBatch(const FiscalReply &reply = FiscalReply());
+    bool endBatch();
+
+    // consumer side, false on timeout or once the queue is closed. While a
+    // document is open control commands wait for the queued normal ones.
+    bool pop(T *item, FiscalReply *reply, bool documentOpen = false, unsigned long msecs = ULONG_MAX);
+    // the replies of the dropped entries are cancelled
+    QList<T> takeAll();
+    // Drops what is left of the document a cancel is about from the normal
+    // lane, so it does not open or go on after the cancel: up to its close
+    // if one is open, else the next document when it is first in line.
+    QList<T> takeDocument(bool documentOpen, DocumentMark (*mark)(const T &));
+    void clear();
+    void close();
+
+    bool isEmpty() const;
+    int size() const;
+    int capacity() const;
+
+private:
+    struct Slot {
+        QAtomicInt sequence;
+        T value;
+        FiscalReply reply;
+        bool last;      // of its batch
+    };
+
+    struct Ring {
+        Slot *cells;
+        int mask;
+        QAtomicInt tail;
+        QAtomicInt head;
+    };
+
+    struct Batch {
+        Batch() : lane(-1), depth(0) {}
+        QList<T> items;
+        FiscalReply reply;
+        int lane;
+        int depth;
+    };
+
+    static int load(const QAtomicInt &a) { return const_cast<QAtomicInt &>(a).fetchAndAddOrdered(0); }
+    static int distance(int a, int b) { return static_cast<int>(static_cast<uint>(a) - static_cast<uint>(b)); }
+
+    Batch *batch();
+    int claim(Ring &ring, int count);
+    void publish(Ring &ring, int pos, const T &item, const FiscalReply &reply, bool last);
+    void wake();
+    bool take(int lane, T *item, FiscalReply *reply);
+    bool takeNext(T *item, FiscalReply *reply, bool documentOpen);
+
+    Ring m_lanes[LaneCount];
+    QAtomicInt m_sleeping;
+    QAtomicInt m_closed;
+    int m_current;  // lane of the batch being sent, under m_mutex
+
+    // serializes the consumer side and parks it when the rings are empty
+    QMutex m_mutex;
+    QWaitCondition m_notEmpty;
+
+    QThreadStorage<Batch *> m_batch;
+};
+
+template <typename T>
+CommandQueue<T>::CommandQueue(int capacity)
+    : m_sleeping(0)
+    , m_closed(0)
+    , m_current(-1)
+{
+    for (int lane = 0; lane < LaneCount; lane++) {
+        // control commands are short and few
+        const int wanted = lane == NormalLane ? capacity : qMin(capacity, 64);
+        int c = 2;
+        while (c < wanted)
+            c <<= 1;
+
+        Ring &ring = m_lanes[lane];
+        ring.cells = new Slot[c];
+        ring.mask = c - 1;
+        ring.tail.fetchAndStoreOrdered(0);
+        ring.head.fetchAndStoreOrdered(0);
+        for (int i = 0; i < c; i++)
+            ring.cells[i].sequence.fetchAndStoreOrdered(i);
+    }
+}
+
+template <typename T>
+CommandQueue<T>::~CommandQueue()
+{
+    for (int lane = 0; lane < LaneCount; lane++)
+        delete [] m_lanes[lane].cells;
+}
+
+template <typename T>
+typename CommandQueue<T>::Batch *CommandQueue<T>::batch()
+{
+    return m_batch.hasLocalData() ? m_batch.localData() : 0;
+}
+
+template <typename T>
+int CommandQueue<T>::claim(Ring &ring, int count)
+{
+    int pos = load(ring.tail);
+    for (;;) {
+        // the consumer frees slots in order, so the last one decides for all
+        const int last = pos + count - 1;
+        const int dif = distance(load(ring.cells[last & ring.mask].sequence), last);
+        if (dif == 0) {
+            if (ring.tail.testAndSetOrdered(pos, pos + count))
+                return pos;
+        } else if (dif < 0) {
+            return -1;
+        }
+        pos = load(ring.tail);
+    }
+}
+
+template <typename T>
+void CommandQueue<T>::publish(Ring &ring, int pos, const T &item, const FiscalReply &reply, bool last)
+{
+    Slot &slot = ring.cells[pos & ring.mask];
+    slot.value = item;
+    slot.reply = reply;
+    slot.last = last;
+    slot.sequence.fetchAndStoreOrdered(pos + 1);
+}
+
+template <typename T>
+void CommandQueue<T>::wake()
+{
+    if (load(m_sleeping)) {
+        QMutexLocker locker(&m_mutex);
+        m_notEmpty.wakeOne();
+    }
+}
+
+template <typename T>
+bool CommandQueue<T>::push(const T &item, FiscalReply reply, CommandLane lane)
+{
+    Batch *b = batch();
+    if (b) {
+        // a mixed batch keeps the lowest lane, so it never overtakes anything it should not
+        b->items.append(item);
+        b->lane = b->lane < 0 ? lane : qMin(b->lane, int(lane));
+        return true;
+    }
+
+    if (load(m_closed)) {
+        reply.cancel();
+        return false;
+    }
+
+    Ring &ring = m_lanes[lane];
+    const int pos = claim(ring, 1);
+    if (pos == -1) {
+        reply.cancel();
+        return false;
+    }
+
+    reply.attach();
+    publish(ring, pos, item, reply, true);
+    wake();
+    return true;
+}
+
+template <typename T>
+bool CommandQueue<T>::push(const QList<T> &items, FiscalReply reply, CommandLane lane)
+{
+    Batch *b = batch();
+    if (b) {
+        b->items += items;
+        if (!items.isEmpty())
+            b->lane = b->lane < 0 ? lane : qMin(b->lane, int(lane));
+        return true;
+    }
+
+    if (items.isEmpty()) {
+        // nothing to send, the command is done already
+        reply.complete(true);
+        return true;
+    }
+
+    Ring &ring = m_lanes[lane];
+    if (load(m_closed) || items.size() > ring.mask + 1) {
+        reply.cancel();
+        return false;
+    }
+
+    const int pos = claim(ring, items.size());
+    if (pos == -1) {
+        reply.cancel();
+        return false;
+    }
+
+    reply.attach(items.size());
+    for (int i = 0; i < items.size(); i++)
+        publish(ring, pos + i, items.at(i), reply, i == items.size() - 1);
+    wake();
+    return true;
+}
+
+template <typename T>
+void CommandQueue<T>::beginBatch(const FiscalReply &reply)
+{
+    Batch *b = batch();
+    if (!b) {
+        b = new Batch;
+        b->reply = reply;
+        m_batch.setLocalData(b);
+    }
+    b->depth++;
+}
+
+template <typename T>
+bool CommandQueue<T>::endBatch()
+{
+    Batch *b = batch();
+    if (!b)
+        return false;
+    if (--b->depth > 0)
+        return true;
+
+    const QList<T> items = b->items;
+    const FiscalReply reply = b->reply;
+    const CommandLane lane = b->lane < 0 ? NormalLane : CommandLane(b->lane);
+    m_batch.setLocalData(0);
+    return push(items, reply, lane);
+}
+
+template <typename T>
+bool CommandQueue<T>::take(int lane, T *item, FiscalReply *reply)
+{
+    Ring &ring = m_lanes[lane];
+    const int head = load(ring.head);
+    Slot &slot = ring.cells[head & ring.mask];
+    if (load(slot.sequence) != head + 1)
+        return false;
+
+    *item = slot.value;
+    *reply = slot.reply;
+    m_current = slot.last ? -1 : lane;
+    slot.value = T();
+    slot.reply = FiscalReply();
+    slot.sequence.fetchAndStoreOrdered(head + ring.mask + 1);
+    ring.head.fetchAndStoreOrdered(head + 1);
+    return true;
+}
+
+template <typename T>
+bool CommandQueue<T>::takeNext(T *item, FiscalReply *reply, bool documentOpen)
+{
+    // the rest of a batch always comes first
+    if (m_current != -1)
+        return take(m_current, item, reply);
+
+    if (take(UrgentLane, item, reply))
+        return true;
+    // inside a document the queued normal commands keep their place
+    if (!documentOpen && take(ControlLane, item, reply))
+        return true;
+    if (take(NormalLane, item, reply))
+        return true;
+    return take(ControlLane, item, reply);
+}
+
+template <typename T>
+bool CommandQueue<T>::pop(T *item, FiscalReply *reply, bool documentOpen, unsigned long msecs)
+{
+    QMutexLocker locker(&m_mutex);
+    for (;;) {
+        if (load(m_closed))
+            return false;
+        if (takeNext(item, reply, documentOpen))
+            return true;
+
+        // announce the sleep before the last look, a producer that published
+        // after it will see the flag and wake us
+        m_sleeping.fetchAndStoreOrdered(1);
+        if (takeNext(item, reply, documentOpen)) {
+            m_sleeping.fetchAndStoreOrdered(0);
+            return true;
+        }
+        const bool woken = m_notEmpty.wait(&m_mutex, msecs);
+        m_sleeping.fetchAndStoreOrdered(0);
+        if (!woken)
+            return takeNext(item, reply, documentOpen);
+    }
+}
+
+template <typename T>
+QList<T> CommandQueue<T>::takeAll()
+{
+    QMutexLocker locker(&m_mutex);
+    QList<T> items;
+    T item;
+    FiscalReply reply;
+    for (int lane = 0; lane < LaneCount; lane++) {
+        while (take(lane, &item, &reply)) {
+            reply.cancel();
+            items.append(item);
+        }
+    }
+    m_current = -1;
+    return items;
+}
+
+template <typename T>
+QList<T> CommandQueue<T>::takeDocument(bool documentOpen, DocumentMark (*mark)(const T &))
+{
+    QMutexLocker locker(&m_mutex);
+    QList<T> items;
+    Ring &ring = m_lanes[NormalLane];
+
+    if (!documentOpen) {
+        const int head = load(ring.head);
+        const Slot &slot = ring.cells[head & ring.mask];
+        if (load(slot.sequence) != head + 1 || mark(slot.value) != OpensDocument)
+            return items;
+    }
+
+    T item;
+    FiscalReply reply;
+    while (take(NormalLane, &item, &reply)) {
+        reply.cancel();
+        items.append(item);
+        if (mark(item) == ClosesDocument)
+            break;
+    }
+    if (m_current == NormalLane)
+        m_current = -1;
+    return items;
+}
+
+template <typename T>
+void CommandQueue<T>::clear()
+{
+    takeAll();
+}
+
+template <typename T>
+void CommandQueue<T>::close()
+{
+    m_closed.fetchAndStoreOrdered(1);
+    QMutexLocker locker(&m_mutex);
+    m_notEmpty.wakeAll();
+}
+
+template <typename T>
+bool CommandQueue<T>::isEmpty() const
+{
+    return size() == 0;
+}
+
+template <typename T>
+int CommandQueue<T>::size() const
+{
+    int size = 0;
+    for (int lane = 0; lane < LaneCount; lane++)
+        size += qMax(0, distance(load(m_lanes[lane].tail), load(m_lanes[lane].head)));
+    return size;
+}
+
+template <typename T>
+int CommandQueue<T>::capacity() const
+{
+    return m_lanes[NormalLane].mask + 1;
+}
+
+#endif // COMMANDQUEUE_H
@@ -93,6 +93,7 @@ bool Connector::isOpen()
 
 void Connector::close()
 {
+    m_rx.clear();
     if (m_serialPort)
         m_serialPort->close();
     else if (m_usbPort)
@@ -124,6 +125,11 @@ void Connector::post(const QVariantMap &body)
     m_networkPort->post(body);
 }
 
+void Connector::postJson(const QByteArray &json)
+{
+    m_networkPort->postJson(json);
+}
+
 const qreal Connector::write(const QByteArray &data)
 {
 #ifdef DEBUG
@@ -136,28 +142,98 @@ const qreal Connector::write(const QByteArray &data)
 
 QByteArray Connector::read(const qreal size)
 {
-    const QByteArray r = m_serialPort ? m_serialPort->read(size) : m_usbPort->read(size);
-
-/*
-#ifdef DEBUG
-    log << QString("Connector::read() %1").arg(r.toHex().constData());
-#endif
-*/
+    if (m_rx.size() < size)
+        fill();
+    return m_rx.read(static_cast<int>(size));
+}
 
-    return r;
+QByteArray Connector::readAll()
+{
+    fill();
+    return m_rx.read(m_rx.size());
+}
 
+const qreal Connector::bytesAvailable()
+{
+    if (m_serialPort)
+        fill();
+    return m_rx.size();
 }
 
-QByteArray Connector::readAll()
+bool Connector::waitForReadyRead(const int msecs)
 {
+    if (!m_rx.isEmpty())
+        return true;
     if (m_serialPort)
-        return m_serialPort->readAll();
-    return m_usbPort->readAll();
+        return m_serialPort->waitForReadyRead(msecs);
+    return m_usbPort->waitForReadyRead(msecs);
 }
 
-const qreal Connector::bytesAvailable()
+void Connector::abortWait()
 {
     if (m_serialPort)
-        return m_serialPort->bytesAvailable();
-    return m_usbPort->bytesAvailable();
+        m_serialPort->abortWait();
+}
+
+bool Connector::getChar(char *c)
+{
+    if (m_rx.isEmpty())
+        fill();
+    return m_rx.getChar(c);
+}
+
+int Connector::peek(char *data, const int maxSize)
+{
+    if (m_rx.size() < maxSize)
+        fill();
+    return m_rx.peek(data, maxSize);
+}
+
+const char *Connector::readPointer(int *size)
+{
+    if (m_rx.isEmpty())
+        fill();
+    return m_rx.readPointer(size);
+}
+
+void Connector::skip(const int size)
+{
+    m_rx.skip(size);
+}
+
+int Connector::fill()
+{
+    int total = 0;
+
+    if (m_usbPort) {
+        // a bulk read blocks, only go to the endpoint when we are out of bytes
+        if (m_rx.isEmpty()) {
+            const QByteArray r = m_usbPort->readAll();
+            m_rx.append(r.constData(), r.size());
+            total = r.size();
+        }
+        return total;
+    }
+
+    if (!m_serialPort)
+        return 0;
+
+    qint64 available = m_serialPort->bytesAvailable();
+    m_rx.reserve(available);
+
+    // at most two reads: up to the end of the ring and then the wrapped part
+    while (available > 0) {
+        int room;
+        char *p = m_rx.writePointer(&room);
+        if (room <= 0)
+            break;
+        const qint64 n = m_serialPort->read(p, qMin<qint64>(room, available));
+        if (n <= 0)
+            break;
+        m_rx.commit(n);
+        total += n;
+        available -= n;
+    }
+
+    return total;
 }
@@ -38,6 +38,7 @@
 #include "serialport.h"
 #include "usbport.h"
 #include "networkport.h"
+#include "ringbuffer.h"
 
 #include <QObject>
 
@@ -58,6 +59,14 @@ public:
     QByteArray read(const qreal size);
     QByteArray readAll();
     const qreal bytesAvailable();
+    bool waitForReadyRead(const int msecs);
+    void abortWait(); // wakes up waitForReadyRead() from another thread
+
+    // direct access to the receive buffer
+    bool getChar(char *c);
+    int peek(char *data, const int maxSize);
+    const char *readPointer(int *size);
+    void skip(const int size);
 
     QVariantMap lastReply() const;
     const int lastError() const;
@@ -70,12 +79,16 @@ private slots:
 
 public slots:
     void post(const QVariantMap &body);
+    void postJson(const QByteArray &json);
 
 private:
+    int fill();
+
     QString m_type;
     SerialPort *m_serialPort;
     UsbPort *m_usbPort;
     NetworkPort *m_networkPort;
+    RingBuffer m_rx;
 };
 
 #endif // CONNECTOR_H
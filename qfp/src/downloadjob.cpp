@@ -0,0 +1,205 @@
+/*
+*
+* Copyright (C)2018, Samuel Isuani <sisuani@gmail.com>
+* All rights reserved.
+*
+* Redistribution and use in source and binary forms, with or without
+* modification, are permitted provided that the following conditions
+* are met:
+*
+* Redistributions of source code must retain the above copyright notice,
+* this list of conditions and the following disclaimer.
+*
+* Redistributions in binary form must reproduce the above copyright
+* notice, this list of conditions and the following disclaimer in the
+* documentation and/or other materials provided with the distribution.
+*
+* Neither the name of the project's author nor the names of its
+* contributors may be used to endorse or promote products derived from
+* this software without specific prior written permission.
+*
+* THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+* "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+* LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+* FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+* HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+* SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED
+* TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+* PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+* LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+* NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+* SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*
+*/
+
+
+#include "downloadjob.h"
+#include "fiscalprinterpool.h"
+#include "pemdecoder.h"
+#include "journalindex.h"
+#include "logger.h"
+
+#include <QFile>
+#include <QRunnable>
+#include <QStringList>
+
+class DownloadTask : public QRunnable
+{
+
+public:
+    DownloadTask(DownloadJob *job, const QString &name, FiscalPrinter *fp)
+        : m_job(job), m_name(name), m_fp(fp) {}
+
+    void run() { m_job->run(m_name, m_fp); }
+
+private:
+    DownloadJob *m_job;
+    QString m_name;
+    FiscalPrinter *m_fp;
+};
+
+DownloadJob::DownloadJob(FiscalPrinterPool *pool, const QString &type, const QDate &from,
+        const QDate &to, const QString &dir, QObject *parent)
+    : QObject(parent)
+    , m_pool(pool)
+    , m_type(type)
+    , m_from(from)
+    , m_to(to)
+    , m_dir(dir)
+    , m_days(0)
+    , m_total(0)
+    , m_bytes(0)
+    , m_running(0)
+    , m_cancel(false)
+{
+    m_threads.setMaxThreadCount(4);
+}
+
+DownloadJob::~DownloadJob()
+{
+    cancel();
+    m_threads.waitForDone();
+}
+
+void DownloadJob::setConcurrency(const int printers)
+{
+    m_threads.setMaxThreadCount(qMax(1, printers));
+}
+
+void DownloadJob::start()
+{
+    QList<FiscalPrinter *> printers;
+    QStringList names;
+    foreach (const QString &name, m_pool->names()) {
+        FiscalPrinter *fp = m_pool->printer(name);
+        // the only one that streams its reports
+        if (fp->model() == FiscalPrinter::EpsonTM900) {
+            printers.append(fp);
+            names.append(name);
+        }
+    }
+
+    {
+        QMutexLocker locker(&m_mutex);
+        m_cancel = false;
+        m_days = 0;
+        m_bytes = 0;
+        m_total = names.size() * (m_from.daysTo(m_to) + 1);
+        m_running = names.size();
+    }
+
+    if (names.isEmpty()) {
+        emit finished();
+        return;
+    }
+
+    for (int i = 0; i < names.size(); i++)
+        m_threads.start(new DownloadTask(this, names.at(i), printers.at(i)));
+}
+
+void DownloadJob::cancel()
+{
+    QMutexLocker locker(&m_mutex);
+    m_cancel = true;
+}
+
+void DownloadJob::run(const QString &name, FiscalPrinter *fp)
+{
+    JournalIndex own(QString("%1/%2.index").arg(m_dir).arg(name));
+    JournalIndex *index = fp->journalIndex() ? fp->journalIndex() : &own;
+    bool ok = index->isOpen();
+
+    for (QDate day = m_from; ok && day <= m_to; day = day.addDays(1)) {
+        if (!index->report(m_type, day).isEmpty()) {
+            dayDone(0);
+            continue;
+        }
+
+        {
+            QMutexLocker locker(&m_mutex);
+            if (m_cancel) {
+                ok = false;
+                break;
+            }
+        }
+
+        qint64 bytes = 0;
+        // the index has every day before this one
+        ok = download(name, fp, index, day, &bytes);
+        if (ok)
+            dayDone(bytes);
+    }
+
+    emit printerFinished(name, ok);
+
+    QMutexLocker locker(&m_mutex);
+    if (--m_running == 0)
+        emit finished();
+}
+
+bool DownloadJob::download(const QString &name, FiscalPrinter *fp, JournalIndex *index,
+        const QDate &day, qint64 *bytes)
+{
+    const QString path = QString("%1/%2-%3-%4.der").arg(m_dir).arg(name).arg(m_type).arg(day.toString("yyyyMMdd"));
+    QFile file(path + ".part");
+    if (!file.open(QIODevice::WriteOnly | QIODevice::Truncate))
+        return false;
+
+    PemDecoder decoder(&file);
+    decoder.open(QIODevice::WriteOnly);
+    const FiscalReply reply = fp->downloadReportByDate(m_type, day, day, &decoder);
+    reply.waitForFinished();
+    file.close();
+
+    if (!reply.isOk() || !decoder.isFinished()) {
+#ifdef DEBUG
+        log << QString("DownloadJob::download() -> %1 %2 failed").arg(name).arg(day.toString("yyyyMMdd"));
+#endif
+        file.remove();
+        return false;
+    }
+
+    QFile::remove(path);
+    if (!file.rename(path))
+        return false;
+
+    // the day counts once it is in the index
+    if (!index->addReport(m_type, day, path, decoder.decoded(), decoder.hash()))
+        return false;
+
+    *bytes = decoder.decoded();
+    return true;
+}
+
+void DownloadJob::dayDone(const qint64 bytes)
+{
+    int days, total;
+    qint64 sum;
+    {
+        QMutexLocker locker(&m_mutex);
+        days = ++m_days;
+        total = m_total;
+        sum = m_bytes += bytes;
+    }
+    emit progress(days, total, sum);
+}
@@ -0,0 +1,95 @@
+/*
+*
+* Copyright (C)2018, Samuel Isuani <sisuani@gmail.com>
+* All rights reserved.
+*
+* Redistribution and use in source and binary forms, with or without
+* modification, are permitted provided that the following conditions
+* are met:
+*
+* Redistributions of source code must retain the above copyright notice,
+* this list of conditions and the following disclaimer.
+*
+* Redistributions in binary form must reproduce the above copyright
+* notice, this list of conditions and the following disclaimer in the
+* documentation and/or other materials provided with the distribution.
+*
+* Neither the name of the project's author nor the names of its
+* contributors may be used to endorse or promote products derived from
+* this software without specific prior written permission.
+*
+* THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+* "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+* LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+* FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+* HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+* SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED
+* TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+* PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+* LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+* NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+* SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*
+*/
+
+
+#ifndef DOWNLOADJOB_H
+#define DOWNLOADJOB_H
+
+#include <QObject>
+#include <QDate>
+#include <QMutex>
+#include <QThreadPool>
+
+class FiscalPrinter;
+class FiscalPrinterPool;
+class JournalIndex;
+
+// Month end report download over every TM-900 of a pool, at most
+// concurrency printers at a time. Each one goes day by day into
+// dir/<printer>-<type>-<yyyyMMdd>.der and files every day it finished in
+// its JournalIndex (dir/<printer>.index if the printer has none), so the
+// same job started again after an interruption only asks for the days
+// missing. The pool must outlive the job.
+class DownloadJob : public QObject
+{
+    Q_OBJECT
+
+public:
+    DownloadJob(FiscalPrinterPool *pool, const QString &type, const QDate &from,
+            const QDate &to, const QString &dir, QObject *parent = 0);
+    ~DownloadJob();
+
+    void setConcurrency(const int printers);
+    void start();
+    void cancel(); // stops once the days being downloaded are done
+
+signals:
+    // days finished over all printers, already indexed ones included
+    void progress(int days, int total, qint64 bytes);
+    void printerFinished(const QString &name, bool ok);
+    void finished();
+
+private:
+    friend class DownloadTask;
+
+    void run(const QString &name, FiscalPrinter *fp);
+    bool download(const QString &name, FiscalPrinter *fp, JournalIndex *index,
+            const QDate &day, qint64 *bytes);
+    void dayDone(const qint64 bytes);
+
+    FiscalPrinterPool *m_pool;
+    QString m_type;
+    QDate m_from;
+    QDate m_to;
+    QString m_dir;
+    QThreadPool m_threads;
+    QMutex m_mutex;
+    int m_days;
+    int m_total;
+    qint64 m_bytes;
+    int m_running;
+    bool m_cancel;
+};
+
+#endif // DOWNLOADJOB_H
@@ -0,0 +1,267 @@
+/*
+*
+* Copyright (C)2018, Samuel Isuani <sisuani@gmail.com>
+* All rights reserved.
+*
+* Redistribution and use in source and binary forms, with or without
+* modification, are permitted provided that the following conditions
+* are met:
+*
+* Redistributions of source code must retain the above copyright notice,
+* this list of conditions and the following disclaimer.
+*
+* Redistributions in binary form must reproduce the above copyright
+* notice, this list of conditions and the following disclaimer in the
+* documentation and/or other materials provided with the distribution.
+*
+* Neither the name of the project's author nor the names of its
+* contributors may be used to endorse or promote products derived from
+* this software without specific prior written permission.
+*
+* THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+* "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+* LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+* FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+* HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+* SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED
+* TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+* PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+* LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+* NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+* SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*
+*/
+
+
+#include "driverfiscal.h"
+#include "fiscalprinter.h"
+#include "replyview.h"
+#include "logger.h"
+
+#include <QTime>
+
+// frames with a bad checksum asked again before giving up on the reply
+static const int MAX_CHECKSUM_NAKS = 3;
+
+FrameDecoder::Event DriverFiscal::readFrame(const int cmd, const qint64 since)
+{
+    const qint64 start = since < 0 ? clock() : since;
+    const int msecs = m_timeouts.timeout(cmd, m_TIME_WAIT);
+    FrameDecoder::Event event = FrameDecoder::None;
+    int naks = 0;
+    QTime timer;
+    timer.start();
+
+    m_decoder.reset();
+
+    while(m_continue && timer.elapsed() < msecs) {
+        int size;
+        const char *data = m_connector->readPointer(&size);
+        if(size <= 0) {
+            // returns as soon as the printer starts answering or on interrupt()
+            m_connector->waitForReadyRead(qMax(0, msecs - timer.elapsed()));
+            continue;
+        }
+
+        m_connector->skip(m_decoder.feed(data, size, &event));
+
+        if(event == FrameDecoder::Busy || event == FrameDecoder::Intermediate) {
+            // the printer is still working on it
+            timer.restart();
+        } else if(event == FrameDecoder::Frame && !m_decoder.checksumOk()) {
+#ifdef DEBUG
+            log << QString("DriverFiscal::readFrame() -> bad checksum: %1").arg(m_decoder.frame().toHex().constData());
+#endif
+            if(++naks > MAX_CHECKSUM_NAKS)
+                return FrameDecoder::None;
+            // the printer sends the reply again
+            m_connector->write(QByteArray(1, PackageFiscal::NAK));
+            timer.restart();
+        } else if(event != FrameDecoder::None) {
+            if(event == FrameDecoder::Frame) {
+                // not from the last keepalive, the printer took all of it
+                m_lastFrame = clock();
+                m_timeouts.addSample(cmd, int(m_lastFrame - start));
+            }
+            return event;
+        }
+    }
+
+    if(m_continue)
+        m_timeouts.timedOut(cmd);
+
+#ifdef DEBUG
+    log << QString("DriverFiscal::readFrame() -> timeout %1 ms (cmd 0x%2)").arg(timer.elapsed()).arg(cmd, 0, 16);
+#endif
+
+    return FrameDecoder::None;
+}
+
+qint64 DriverFiscal::clock() const
+{
+    return m_clock.elapsed();
+}
+
+void DriverFiscal::pause(const int msecs)
+{
+    QMutexLocker locker(&m_waitMutex);
+    if(m_continue)
+        m_interrupted.wait(&m_waitMutex, msecs);
+}
+
+bool DriverFiscal::setJournal(CommandJournal *journal)
+{
+    Q_UNUSED(journal);
+    return false;
+}
+
+bool DriverFiscal::setDownloadSink(QIODevice *sink)
+{
+    Q_UNUSED(sink);
+    return false;
+}
+
+void DriverFiscal::voidDocument()
+{
+    cancel();
+}
+
+bool DriverFiscal::canVoid()
+{
+    return true;
+}
+
+void DriverFiscal::interrupt()
+{
+    {
+        QMutexLocker locker(&m_waitMutex);
+        m_continue = false;
+        m_interrupted.wakeAll();
+    }
+    m_connector->abortWait();
+}
+
+void DriverFiscal::statusWords(const QByteArray &data, int *printer, int *fiscal)
+{
+    // STX SEQ CMD FS PPPP FS FFFF, both words in hex
+    const ReplyView reply(data);
+    *printer = reply.hexWord(4);
+    *fiscal = reply.hexWord(9);
+}
+
+int DriverFiscal::status()
+{
+    QMutexLocker locker(&m_statusMutex);
+    return m_status;
+}
+
+FiscalReply DriverFiscal::cachedStatus(const int maxAge)
+{
+    QMutexLocker locker(&m_statusMutex);
+    if(!m_statusAge.isValid() || m_statusAge.elapsed() > maxAge)
+        return FiscalReply();
+
+    FiscalReply reply = FiscalReply::create();
+    reply.setStatus(m_printerWord, m_fiscalWord);
+    reply.setValue(m_status);
+    reply.complete(true);
+    return reply;
+}
+
+int DriverFiscal::decodeStatus(const int printer, const int fiscal)
+{
+    int status = 0;
+
+    if(printer & (1 << 2))
+        status |= FiscalPrinter::PrinterError;
+    if(printer & (1 << 3))
+        status |= FiscalPrinter::PrinterOffline;
+    if(printer & ((1 << 4) | (1 << 5))) // journal, receipt
+        status |= FiscalPrinter::PaperOut;
+    if(printer & (1 << 8))
+        status |= FiscalPrinter::CoverOpen;
+    if(printer & (1 << 14))
+        status |= FiscalPrinter::DrawerOpen;
+
+    if(fiscal & ((1 << 0) | (1 << 1))) // fiscal, working memory
+        status |= FiscalPrinter::FiscalMemoryError;
+    if(fiscal & (1 << 7))
+        status |= FiscalPrinter::FiscalMemoryFull;
+    if(fiscal & (1 << 8))
+        status |= FiscalPrinter::FiscalMemoryNearFull;
+    if(fiscal & (1 << 12))
+        status |= FiscalPrinter::FiscalDocumentOpen;
+    if(fiscal & (1 << 13))
+        status |= FiscalPrinter::DocumentOpen;
+
+    return status;
+}
+
+bool DriverFiscal::documentOpen()
+{
+    return status() & (FiscalPrinter::FiscalDocumentOpen | FiscalPrinter::DocumentOpen);
+}
+
+void DriverFiscal::updateStatus(const int status, const int printer, const int fiscal)
+{
+    int previous;
+    {
+        QMutexLocker locker(&m_statusMutex);
+        previous = m_status;
+        m_status = status;
+        m_printerWord = printer;
+        m_fiscalWord = fiscal;
+        m_statusAge.start();
+    }
+
+    if(previous != status)
+        emit statusChanged(status, previous ^ status);
+}
+
+bool DriverFiscal::reportOk(const bool ok, const bool asked)
+{
+    const bool report = ok && (asked || !m_lastOk);
+    m_lastOk = ok;
+    return report;
+}
+
+void DriverFiscal::printReceipt(const FiscalReceipt &receipt)
+{
+    beginBatch();
+
+    const QVector<FiscalReceipt::Step> &steps = receipt.steps();
+    for(int i = 0; i < steps.size(); i++) {
+        const FiscalReceipt::Step &s = steps.at(i);
+        switch(s.command) {
+        case FiscalReceipt::CustomerData:
+            setCustomerData(s.text, s.text2, s.code, s.text3, s.text4);
+            break;
+        case FiscalReceipt::Open:
+            openFiscalReceipt(s.code);
+            break;
+        case FiscalReceipt::FiscalText:
+            printFiscalText(s.text);
+            break;
+        case FiscalReceipt::LineItem:
+            printLineItem(s.text, s.value, s.value2, s.text2, s.code, s.value3);
+            break;
+        case FiscalReceipt::Perceptions:
+            perceptions(s.text, s.value);
+            break;
+        case FiscalReceipt::Subtotal:
+            subtotal(s.code);
+            break;
+        case FiscalReceipt::GeneralDiscount:
+            generalDiscount(s.text, s.value, s.value2, s.code);
+            break;
+        case FiscalReceipt::TotalTender:
+            totalTender(s.text, s.value, s.code);
+            break;
+        case FiscalReceipt::Close:
+            closeFiscalReceipt(s.code, s.code2, s.id);
+            break;
+        }
+    }
+
+    endBatch();
+}
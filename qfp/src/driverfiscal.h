@@ -39,20 +39,28 @@
 #include <QThread>
 #include <QDate>
 #include <QDebug>
+#include <QMutex>
+#include <QElapsedTimer>
+#include <QWaitCondition>
 
 #include "packagefiscal.h"
+#include "framedecoder.h"
+#include "timeoutmodel.h"
+#include "commandqueue.h"
+#include "fiscalreceipt.h"
 #include "connector.h"
 
 #define LOGGER 1
 
-#define TIME_WAIT 350
-#define MAX_TW 150
+class CommandJournal;
+class QIODevice;
 
 class DriverFiscal
 {
 
 public:
-    DriverFiscal(QObject *parent = 0, Connector *m_connector = 0, int m_TIME_WAIT = 300) : m_connector(m_connector) {};
+    DriverFiscal(QObject *parent = 0, Connector *m_connector = 0, int m_TIME_WAIT = 300)
+        : m_connector(m_connector), m_TIME_WAIT(m_TIME_WAIT), m_lastFrame(0), m_status(0), m_printerWord(0), m_fiscalWord(0), m_lastOk(false) { m_clock.start(); };
     virtual ~DriverFiscal() {};
 
     enum {
@@ -100,10 +108,38 @@ public:
     virtual void reprintContinue() = 0;
     virtual void reprintFinalize() = 0;
     virtual void cancel() = 0;
+    // Voids the document being built behind the frames already queued for
+    // it, where cancel() jumps ahead of them; the default is cancel()
+    virtual void voidDocument();
+    // false if cancel() can't void a document on this printer
+    virtual bool canVoid();
     virtual void ack() = 0;
     virtual void setDateTime(const QDateTime &dateTime) = 0;
     virtual void setFixedData(const QString &shop, const QString &phone) = 0;
     virtual void finish() = 0;
+    virtual int queueDepth() = 0;
+    // journal of the open document, replayed against the printer when a
+    // previous run left one; false if the driver can't recover from it
+    virtual bool setJournal(CommandJournal *journal);
+    // the next report download goes into sink, continued and finalized by
+    // the driver itself; false if unsupported or one is in progress
+    virtual bool setDownloadSink(QIODevice *sink);
+    int status(); // last known FiscalPrinter::StatusFlags
+    // finished reply with the last known status if not older than maxAge ms,
+    // null otherwise
+    FiscalReply cachedStatus(const int maxAge);
+
+    // the commands issued between these go to the queue as one batch,
+    // reply finishes once the printer answered all of them
+    virtual void beginBatch(const FiscalReply &reply = FiscalReply()) = 0;
+    virtual void endBatch() = 0;
+
+    // Builds each step's package straight from its typed arguments, inside
+    // one batch so the whole document goes to the queue in a single push
+    void printReceipt(const FiscalReceipt &receipt);
+
+    // printer and fiscal status words of a reply
+    virtual void statusWords(const QByteArray &data, int *printer, int *fiscal);
 
     virtual void getTransactionalMemoryInfo() = 0;
     virtual void downloadReportByDate(const QString &type, const QDate &form, const QDate &to) = 0;
@@ -115,18 +151,49 @@ public:
 
 protected:
     virtual void fiscalReceiptNumber(int id, int number, int type) = 0; // type == 0 Factura, == 1 NC
+    virtual void statusChanged(int status, int changed) = 0;
+
+    // Printer and fiscal status words to FiscalPrinter::StatusFlags,
+    // the default follows the Epson / Hasar serial bit layout
+    virtual int decodeStatus(const int printer, const int fiscal);
+    // A fiscal or non fiscal document is open as of the last reply
+    bool documentOpen();
+    // Keeps the last known flags and words, signals only the bits that changed
+    void updateStatus(const int status, const int printer = 0, const int fiscal = 0);
+    // Tells if a reply is worth a fiscalStatus(Ok): only after a failure
+    // or when the status was asked for
+    bool reportOk(const bool ok, const bool asked);
+
+    // Waits for the next Frame or Nak from the printer, None on timeout.
+    // A frame with a bad checksum is NAKed so the printer sends it again.
+    // The deadline is learned per command by m_timeouts, from since (a
+    // clock() time, default now) to the frame.
+    FrameDecoder::Event readFrame(const int cmd, const qint64 since = -1);
+    // ms on a monotonic clock, for the since above
+    qint64 clock() const;
+
+    // Sleeps up to msecs, returns early once interrupt() is called
+    void pause(const int msecs);
+    // Stops the worker: clears m_continue and wakes up every wait above
+    void interrupt();
+
     Connector *m_connector;
+    FrameDecoder m_decoder;
+    TimeoutModel m_timeouts;
     int m_TIME_WAIT;
     bool m_continue;
-};
+    qint64 m_lastFrame; // clock() when the last frame came in
 
-class SleeperThread : public QThread
-{
-    public:
-        static void msleep(unsigned long msecs)
-        {
-            QThread::msleep(msecs);
-        }
+private:
+    QElapsedTimer m_clock;
+    QMutex m_waitMutex;
+    QWaitCondition m_interrupted;
+    QMutex m_statusMutex;
+    QElapsedTimer m_statusAge;
+    int m_status;
+    int m_printerWord;
+    int m_fiscalWord;
+    bool m_lastOk;
 };
 
 #endif // DRIVERFISCAL_H
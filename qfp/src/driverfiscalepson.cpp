@@ -34,22 +34,23 @@
 
 #include "driverfiscalepson.h"
 #include "packagefiscal.h"
+#include "replyview.h"
 #include "logger.h"
 
 #include <QCoreApplication>
 #include <QDateTime>
 #include <QDir>
 
-int PackageEpson::m_secuence = 0x20;
-
 DriverFiscalEpson::DriverFiscalEpson(QObject *parent, Connector *m_connector)
     : QThread(parent), DriverFiscal(parent, m_connector)
 {
     m_nak_count = 0;
+    m_secuence = 0x20;
     m_error = false;
     m_isinvoice = false;
     m_continue = true;
     clear();
+    start();
 }
 
 void DriverFiscalEpson::setModel(const FiscalPrinter::Model model)
@@ -59,172 +60,138 @@ void DriverFiscalEpson::setModel(const FiscalPrinter::Model model)
 
 void DriverFiscalEpson::finish()
 {
-    m_continue = false;
-    queue.clear();
-    quit();
+    interrupt();
+    qDeleteAll(queue.takeAll());
+    queue.close();
+    wait();
+}
 
-    while(isRunning()) {
-        msleep(100);
-        quit();
-    }
+int DriverFiscalEpson::queueDepth()
+{
+    return queue.size();
+}
+
+void DriverFiscalEpson::beginBatch(const FiscalReply &reply)
+{
+    queue.beginBatch(reply);
+}
+
+void DriverFiscalEpson::endBatch()
+{
+    queue.endBatch();
+}
+
+int DriverFiscalEpson::nextSecuence()
+{
+    const int secuence = m_secuence;
+    if(++m_secuence >= 0x7f)
+        m_secuence = 0x20;
+    return secuence;
 }
 
 void DriverFiscalEpson::run()
 {
+    PackageEpson *pkg = 0;
+    FiscalReply reply;
+
+    // the worker lives as long as the driver, finish() closes the queue
+    while(m_continue) {
+        if(!pkg) {
+            if(!queue.pop(&pkg, &reply, documentOpen()))
+                break;
+            pkg->setSecuence(nextSecuence());
+        }
 
-    while(!queue.empty() && m_continue) {
-        PackageEpson *pkg = queue.first();
         m_connector->write(pkg->fiscalPackage());
 
         QByteArray ret = readData(pkg->cmd(), pkg->secuence());
         if(!ret.isEmpty()) {
             if(ret.at(0) == PackageFiscal::NAK && m_nak_count <= 3) { // ! NAK
                 m_nak_count++;
-                SleeperThread::msleep(100);
+                pause(100);
                 continue;
             }
 
             m_nak_count = 0;
 
+            int printer, fiscal;
+            statusWords(ret, &printer, &fiscal);
+            reply.setStatus(printer, fiscal);
+            updateStatus(decodeStatus(printer, fiscal), printer, fiscal);
+            if(pkg->cmd() == CMD_STATUS)
+                reply.setValue(status());
+
             if(pkg->cmd() == CMD_CLOSEFISCALRECEIPT_INVOICE ||
                     pkg->cmd() == CMD_CLOSEFISCALRECEIPT_TICKET || pkg->cmd() == CMD_CLOSEDNFH) {
+                const int number = getReceiptNumber(ret);
+                reply.setValue(number);
                 if(pkg->data()[0] == 'M') {
-                    emit fiscalReceiptNumber(pkg->id(), getReceiptNumber(ret), 1);
+                    emit fiscalReceiptNumber(pkg->id(), number, 1);
                 } else {
-                    emit fiscalReceiptNumber(pkg->id(), getReceiptNumber(ret), 0);
+                    emit fiscalReceiptNumber(pkg->id(), number, 0);
                 }
             }
 
-            queue.pop_front();
+            reply.complete(true, ret);
             delete pkg;
+            pkg = 0;
 
         } else {
 #ifdef DEBUG
             log << QString("DriverFiscalEpson::run() -> fiscal error?");
 #endif
-            queue.clear();
+            reply.complete(false);
+            delete pkg;
+            pkg = 0;
+            qDeleteAll(queue.takeAll());
         }
     }
+
+    reply.cancel();
+    delete pkg;
 }
 
 int DriverFiscalEpson::getReceiptNumber(const QByteArray &data)
 {
-    QByteArray tmp = data;
-    tmp.remove(0, 14);
-    for(int i = 0; i < tmp.size(); i++) {
-        if(tmp.at(i) == PackageFiscal::ETX) {
-            tmp.remove(i, tmp.size());
-            break;
-        }
-    }
+    const int number = ReplyView::toInt(ReplyView(data).mid(14));
 
 #ifdef DEBUG
-    log << QString("DriverFiscalEpson::getReceiptNumber() -> F. Num: %1").arg(tmp.trimmed().toInt());
+    log << QString("DriverFiscalEpson::getReceiptNumber() -> F. Num: %1").arg(number);
 #endif
-    return tmp.trimmed().toInt();
+    return number;
 }
 
 bool DriverFiscalEpson::getStatus(const QByteArray &data)
 {
-    QByteArray tmp = data;
-    tmp.remove(0, 11);
-    tmp.remove(5, tmp.size());
-
-    return tmp == QByteArray("0000");
+    return ReplyView(data).mid(11, 5) == "0000";
 }
 
 QByteArray DriverFiscalEpson::readData(const int pkg_cmd, const QByteArray &secuence)
 {
-    bool ok = false;
-    int count_tw = 0;
     QByteArray bytes;
 
-    do {
-        if(m_connector->type().compare("COM") == 0  && (m_connector->bytesAvailable() <= 0 && m_continue)) {
-            //log << QString("NB tw");
-            count_tw++;
-            SleeperThread::msleep(100);
-        }
-
-        if(!m_continue)
-            return "";
-
-        QByteArray bufferBytes = m_connector->read(1);
-        if(bufferBytes.at(0) == PackageFiscal::DC1 || bufferBytes.at(0) == PackageFiscal::DC2
-                || bufferBytes.at(0) == PackageFiscal::DC3 || bufferBytes.at(0) == PackageFiscal::DC4
-                || bufferBytes.at(0) == PackageFiscal::FNU) {
-            SleeperThread::msleep(100);
-            //count_tw -= 20;
-            continue;
-        } else if(bufferBytes.at(0) == PackageFiscal::NAK) {
-            continue;
-            //return bufferBytes;
-        } else if(bufferBytes.at(0) == PackageFiscal::STX) {
-            bytes += PackageFiscal::STX;
-
-            bufferBytes = m_connector->read(1);
 #ifdef DEBUG
-            log << QString("DriverFiscalEpson::readData() -> read : %1").arg(secuence.toHex().constData());
+    log << QString("DriverFiscalEpson::readData() -> read : %1").arg(secuence.toHex().constData());
 #endif
-            bool has_cmd = false;
-            while(bufferBytes.at(0) != PackageFiscal::ETX) {
-                count_tw++;
-                if(bufferBytes.isEmpty()) {
-                    SleeperThread::msleep(100);
-                }
-
-                if (!has_cmd) {
-                    if (!bufferBytes.isEmpty()) {
-                        if (QString::number(bufferBytes.at(0), 16).toUtf8() == secuence) {
-                            has_cmd = true;
-                            bytes += bufferBytes;
-                        }
-                    }
-                } else {
-                    bytes += bufferBytes;
-                }
-
-                bufferBytes = m_connector->read(1);
-
-                if(count_tw >= MAX_TW)
-                    break;
-            }
-
-            bytes += PackageFiscal::ETX;
-
-            QByteArray checkSumArray;
-            int checksumCount = 0;
-            while(checksumCount != 4 && m_continue) {
-                checkSumArray = m_connector->read(1);
-                count_tw++;
-                if(checkSumArray.isEmpty()) {
-                    SleeperThread::msleep(100);
-                } else {
-                    checksumCount++;
-                    bytes += checkSumArray;
-                }
 
-                if(count_tw >= MAX_TW)
-                    break;
-            }
-
-            ok = true;
+    // NAKs and answers to a previous secuence are skipped
+    const qint64 sent = clock();
+    FrameDecoder::Event event;
+    while((event = readFrame(pkg_cmd, sent)) != FrameDecoder::None) {
+        if(event == FrameDecoder::Frame
+                && QString::number(m_decoder.sequence(), 16).toUtf8() == secuence) {
+            bytes = m_decoder.frame();
             break;
-        } else {
-            bytes += bufferBytes;
         }
-        count_tw++;
+    }
 
-    } while(ok != true && count_tw <= MAX_TW && m_continue);
+    if(!m_continue)
+        return "";
 
-#ifdef DEBUG
-    log << QString("DriverFiscalEpson::readData() -> counter: %1 %2").arg(count_tw).arg(MAX_TW);
-#endif
-
-    bytes = bytes.remove(0, bytes.lastIndexOf(PackageFiscal::STX));
-    ok = verifyResponse(bytes, pkg_cmd);
+    const bool ok = verifyResponse(bytes, pkg_cmd);
 
     if(!ok) {
+        reportOk(false, false);
 #ifdef DEBUG
         log << QString("DriverFiscalEpson::readData() -> error read: %1").arg(bytes.toHex().data());
 #endif
@@ -237,7 +204,8 @@ QByteArray DriverFiscalEpson::readData(const int pkg_cmd, const QByteArray &secu
 #ifdef DEBUG
         log << QString("DriverFiscalEpson::readData() -> OK PKGV3: %1").arg(bytes.toHex().data());
 #endif
-        emit fiscalStatus(FiscalPrinter::Ok);
+        if(reportOk(true, pkg_cmd == CMD_STATUS))
+            emit fiscalStatus(FiscalPrinter::Ok);
     }
 
     return bytes;
@@ -322,8 +290,7 @@ void DriverFiscalEpson::statusRequest()
     p->setCmd(CMD_STATUS);
     p->setData(QByteArray("S"));
 
-    queue.append(p);
-    start();
+    queue.push(p, FiscalReply(), ControlLane);
 }
 
 void DriverFiscalEpson::dailyClose(const char type)
@@ -337,8 +304,7 @@ void DriverFiscalEpson::dailyClose(const char type)
     d.append('P');
     p->setData(d);
 
-    queue.append(p);
-    start();
+    queue.push(p);
 }
 
 void DriverFiscalEpson::dailyCloseByDate(const QDate &from, const QDate &to)
@@ -354,8 +320,7 @@ void DriverFiscalEpson::dailyCloseByDate(const QDate &from, const QDate &to)
     d.append('T');
     p->setData(d);
 
-    queue.append(p);
-    start();
+    queue.push(p);
 }
 
 void DriverFiscalEpson::dailyCloseByNumber(const int from, const int to)
@@ -371,8 +336,7 @@ void DriverFiscalEpson::dailyCloseByNumber(const int from, const int to)
     d.append('T');
     p->setData(d);
 
-    queue.append(p);
-    start();
+    queue.push(p);
 }
 
 void DriverFiscalEpson::setCustomerData(const QString &name, const QString &cuit, const char tax_type,
@@ -449,8 +413,7 @@ void DriverFiscalEpson::openFiscalReceipt(const char type)
     d.append('C');
     p->setData(d);
 
-    queue.append(p);
-    start();
+    queue.push(p);
 }
 
 void DriverFiscalEpson::printFiscalText(const QString &text)
@@ -509,8 +472,7 @@ void DriverFiscalEpson::printLineItem(const QString &description, const qreal qu
     }
     p->setData(d);
 
-    queue.append(p);
-    start();
+    queue.push(p);
 
 }
 
@@ -529,8 +491,7 @@ void DriverFiscalEpson::perceptions(const QString &desc, qreal tax_amount)
     d.append("0");
     p->setData(d);
 
-    queue.append(p);
-    start();
+    queue.push(p);
 }
 
 void DriverFiscalEpson::subtotal(const char print)
@@ -544,8 +505,7 @@ void DriverFiscalEpson::subtotal(const char print)
     d.append("Subtotal");
     p->setData(d);
 
-    queue.append(p);
-    start();
+    queue.push(p);
 }
 
 void DriverFiscalEpson::totalTender(const QString &description, const qreal amount, const char type)
@@ -561,8 +521,7 @@ void DriverFiscalEpson::totalTender(const QString &description, const qreal amou
     d.append(type);
     p->setData(d);
 
-    queue.append(p);
-    start();
+    queue.push(p);
 }
 
 void DriverFiscalEpson::generalDiscount(const QString &description, const qreal amount, const qreal tax_percent, const char type)
@@ -610,8 +569,7 @@ void DriverFiscalEpson::generalDiscount(const QString &description, const qreal
     }
     p->setData(d);
 
-    queue.append(p);
-    start();
+    queue.push(p);
 
 }
 
@@ -636,8 +594,7 @@ void DriverFiscalEpson::closeFiscalReceipt(const char intype, const char type, c
     clear();
 
     p->setData(d);
-    queue.append(p);
-    start();
+    queue.push(p);
 
 }
 
@@ -650,22 +607,23 @@ void DriverFiscalEpson::openNonFiscalReceipt()
     d.append(" ");
     p->setData(d);
 
-    queue.append(p);
-    start();
+    queue.push(p);
 }
 
 void DriverFiscalEpson::printNonFiscalText(const QString &text)
 {
+    QList<PackageEpson *> batch;
+
     QString t = text;
     while(!t.isEmpty()) {
         PackageEpson *p = new PackageEpson;
         p->setCmd(CMD_PRINTNONTFISCALTEXT);
         p->setData(t.left(40));
         t.remove(0, 40);
-        queue.append(p);
+        batch.append(p);
     }
 
-    start();
+    queue.push(batch);
 }
 
 void DriverFiscalEpson::closeNonFiscalReceipt()
@@ -677,8 +635,7 @@ void DriverFiscalEpson::closeNonFiscalReceipt()
     d.append('T');
     p->setData(d);
 
-    queue.append(p);
-    start();
+    queue.push(p);
 }
 
 void DriverFiscalEpson::openDrawer()
@@ -686,8 +643,7 @@ void DriverFiscalEpson::openDrawer()
     PackageEpson *p = new PackageEpson;
     p->setCmd(CMD_OPENDRAWER);
 
-    queue.append(p);
-    start();
+    queue.push(p, FiscalReply(), ControlLane);
 }
 
 void DriverFiscalEpson::setHeaderTrailer(const QString &header, const QString &trailer)
@@ -745,8 +701,7 @@ void DriverFiscalEpson::openDNFH(const char type, const char fix_value, const QS
     d.append('C');
     p->setData(d);
 
-    queue.append(p);
-    start();
+    queue.push(p);
 }
 
 void DriverFiscalEpson::printEmbarkItem(const QString &description, const qreal quantity)
@@ -771,12 +726,57 @@ void DriverFiscalEpson::closeDNFH(const int id, const char f_type, const int cop
 
     p->setData(d);
 
-    queue.append(p);
-    start();
+    queue.push(p);
+}
+
+static DocumentMark documentMark(PackageEpson * const &p)
+{
+    switch(p->cmd()) {
+    case DriverFiscalEpson::CMD_OPENTICKET:
+    case DriverFiscalEpson::CMD_OPENFISCALRECEIPT:
+    case DriverFiscal::CMD_OPENNONFISCALRECEIPT:
+        return OpensDocument;
+    case DriverFiscalEpson::CMD_CLOSEFISCALRECEIPT_TICKET:
+    case DriverFiscalEpson::CMD_CLOSEFISCALRECEIPT_INVOICE:
+    case DriverFiscalEpson::CMD_CLOSEDNFH:
+    case DriverFiscal::CMD_CLOSENONFISCALRECEIPT:
+        return ClosesDocument;
+    case DriverFiscalEpson::CMD_TOTALTENDER_TICKET:
+    case DriverFiscalEpson::CMD_TOTALTENDER_INVOICE:
+        // a payment qualified 'C' cancels the document
+        if(p->data().endsWith(QChar('C')))
+            return ClosesDocument;
+        break;
+    }
+    return NoMark;
+}
+
+PackageEpson *DriverFiscalEpson::cancelPackage()
+{
+    PackageEpson *p = new PackageEpson;
+    p->setCmd(m_isinvoice ? CMD_TOTALTENDER_INVOICE : CMD_TOTALTENDER_TICKET);
+
+    QByteArray d;
+    d.append("Cancelar");
+    d.append(PackageFiscal::FS);
+    d.append(QByteArray(9, '0'));
+    d.append(PackageFiscal::FS);
+    d.append('C');
+    p->setData(d);
+    return p;
 }
 
 void DriverFiscalEpson::cancel()
 {
+    // the frames of the document it voids would open or go on after it
+    qDeleteAll(queue.takeDocument(documentOpen(), documentMark));
+
+    queue.push(cancelPackage(), FiscalReply(), UrgentLane);
+}
+
+void DriverFiscalEpson::voidDocument()
+{
+    queue.push(cancelPackage());
 }
 
 void DriverFiscalEpson::ack()
@@ -794,9 +794,7 @@ void DriverFiscalEpson::setDateTime(const QDateTime &dateTime)
     d.append(dateTime.toString("HHmmss").toLatin1());
 
     p->setData(d);
-    queue.append(p);
-
-    start();
+    queue.push(p);
 }
 
 void DriverFiscalEpson::clear()
@@ -828,6 +826,8 @@ void DriverFiscalEpson::reprintFinalize()
 
 void DriverFiscalEpson::setFixedData(const QString &shop, const QString &phone)
 {
+    QList<PackageEpson *> batch;
+
     QByteArray d;
 
     PackageEpson *pp = new PackageEpson;
@@ -837,7 +837,7 @@ void DriverFiscalEpson::setFixedData(const QString &shop, const QString &phone)
     d.append(PackageFiscal::FS);
     d.append("DEFENSA CONSUMIDOR " + phone);
     pp->setData(d);
-    queue.append(pp);
+    batch.append(pp);
     d.clear();
 
     PackageEpson *p = new PackageEpson;
@@ -847,7 +847,7 @@ void DriverFiscalEpson::setFixedData(const QString &shop, const QString &phone)
     d.append(PackageFiscal::FS);
     d.append("Ingresa en www.global.subway.com");
     p->setData(d);
-    queue.append(p);
+    batch.append(p);
     d.clear();
 
     PackageEpson *p1 = new PackageEpson;
@@ -857,7 +857,7 @@ void DriverFiscalEpson::setFixedData(const QString &shop, const QString &phone)
     d.append(PackageFiscal::FS);
     d.append("Danos tu opinion y guarda el recibo para");
     p1->setData(d);
-    queue.append(p1);
+    batch.append(p1);
     d.clear();
 
     PackageEpson *p2 = new PackageEpson;
@@ -867,7 +867,7 @@ void DriverFiscalEpson::setFixedData(const QString &shop, const QString &phone)
     d.append(PackageFiscal::FS);
     d.append("obtener una COOKIE GRATIS en tu proxima");
     p2->setData(d);
-    queue.append(p2);
+    batch.append(p2);
     d.clear();
 
     PackageEpson *p3 = new PackageEpson;
@@ -877,7 +877,7 @@ void DriverFiscalEpson::setFixedData(const QString &shop, const QString &phone)
     d.append(PackageFiscal::FS);
     d.append("compra. Valido dentro de los 5 dias de");
     p3->setData(d);
-    queue.append(p3);
+    batch.append(p3);
     d.clear();
 
     PackageEpson *p4 = new PackageEpson;
@@ -887,7 +887,7 @@ void DriverFiscalEpson::setFixedData(const QString &shop, const QString &phone)
     d.append(PackageFiscal::FS);
     d.append(QString("emision del ticket. Tienda: %1-0").arg(shop));
     p4->setData(d);
-    queue.append(p4);
+    batch.append(p4);
     d.clear();
 
     PackageEpson *p5 = new PackageEpson;
@@ -897,7 +897,7 @@ void DriverFiscalEpson::setFixedData(const QString &shop, const QString &phone)
     d.append(PackageFiscal::FS);
     d.append(0x7f);
     p5->setData(d);
-    queue.append(p5);
+    batch.append(p5);
     d.clear();
 
     PackageEpson *p6 = new PackageEpson;
@@ -907,7 +907,7 @@ void DriverFiscalEpson::setFixedData(const QString &shop, const QString &phone)
     d.append(PackageFiscal::FS);
     d.append(0x7f);
     p6->setData(d);
-    queue.append(p6);
+    batch.append(p6);
     d.clear();
 
     PackageEpson *p7 = new PackageEpson;
@@ -917,7 +917,7 @@ void DriverFiscalEpson::setFixedData(const QString &shop, const QString &phone)
     d.append(PackageFiscal::FS);
     d.append(0x7f);
     p7->setData(d);
-    queue.append(p7);
+    batch.append(p7);
     d.clear();
 
     PackageEpson *p8 = new PackageEpson;
@@ -927,7 +927,7 @@ void DriverFiscalEpson::setFixedData(const QString &shop, const QString &phone)
     d.append(PackageFiscal::FS);
     d.append(0x7f);
     p8->setData(d);
-    queue.append(p8);
+    batch.append(p8);
     d.clear();
 
     PackageEpson *p9 = new PackageEpson;
@@ -937,10 +937,10 @@ void DriverFiscalEpson::setFixedData(const QString &shop, const QString &phone)
     d.append(PackageFiscal::FS);
     d.append(0x7f);
     p9->setData(d);
-    queue.append(p9);
+    batch.append(p9);
     d.clear();
 
-    start();
+    queue.push(batch);
 }
 
 void DriverFiscalEpson::getTransactionalMemoryInfo()
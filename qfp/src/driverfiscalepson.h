@@ -99,10 +99,14 @@ public:
     virtual void reprintContinue();
     virtual void reprintFinalize();
     virtual void cancel();
+    virtual void voidDocument();
     virtual void ack();
     virtual void setDateTime(const QDateTime &dateTime);
     virtual void setFixedData(const QString &shop, const QString &phone);
     virtual void finish();
+    virtual int queueDepth();
+    virtual void beginBatch(const FiscalReply &reply = FiscalReply());
+    virtual void endBatch();
 
     virtual void getTransactionalMemoryInfo();
     virtual void downloadReportByDate(const QString &type, const QDate &form, const QDate &to);
@@ -115,16 +119,20 @@ signals:
     void fiscalReceiptNumber(int id, int number, int type); // type == 0 Factura, == 1 NC
     void fiscalStatus(int state);
     void fiscalData(int cmd, QVariant data);
+    void statusChanged(int status, int changed);
 
 protected:
     void run();
 
 private:
+    int nextSecuence();
+    PackageEpson *cancelPackage();
     bool m_error;
     bool m_isinvoice;
-    QVector<PackageEpson *> queue;
+    CommandQueue<PackageEpson *> queue;
     FiscalPrinter::Model m_model;
     int m_nak_count;
+    int m_secuence;
 
     void clear();
     QString m_name;
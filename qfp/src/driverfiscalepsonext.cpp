@@ -34,23 +34,31 @@
 
 #include "driverfiscalepsonext.h"
 #include "packagefiscal.h"
+#include "replyview.h"
 #include "logger.h"
 
 #include <QCoreApplication>
 #include <QDateTime>
 #include <QDir>
+#include <QIODevice>
 
-int PackageEpsonExt::m_secuence = 0x81;
+// last line of the CMS the printer hands out, the download is complete
+static const char CMS_END[] = "-----END CMS-----";
 
 DriverFiscalEpsonExt::DriverFiscalEpsonExt(QObject *parent, Connector *m_connector)
     : QThread(parent), DriverFiscal(parent, m_connector)
 {
     m_nak_count = 0;
+    m_readSince = -1;
+    m_secuence = 0x81;
     m_error = false;
     m_isinvoice = false;
     m_iscreditnote = false;
+    m_window = 1;
+    m_downloaded = 0;
     m_continue = true;
     clear();
+    start();
 }
 
 void DriverFiscalEpsonExt::setModel(const FiscalPrinter::Model model)
@@ -60,233 +68,330 @@ void DriverFiscalEpsonExt::setModel(const FiscalPrinter::Model model)
 
 void DriverFiscalEpsonExt::finish()
 {
-    m_continue = false;
-    queue.clear();
-    quit();
+    interrupt();
+    qDeleteAll(queue.takeAll());
+    queue.close();
+    wait();
+}
 
-    while(isRunning()) {
-        msleep(100);
-        quit();
-    }
+int DriverFiscalEpsonExt::queueDepth()
+{
+    return queue.size();
+}
+
+void DriverFiscalEpsonExt::beginBatch(const FiscalReply &reply)
+{
+    queue.beginBatch(reply);
+}
+
+void DriverFiscalEpsonExt::endBatch()
+{
+    queue.endBatch();
+}
+
+int DriverFiscalEpsonExt::nextSecuence()
+{
+    const int secuence = m_secuence;
+    if(++m_secuence >= 0xff)
+        m_secuence = 0x81;
+    return secuence;
+}
+
+void DriverFiscalEpsonExt::setWindow(const int frames)
+{
+    m_window = qMax(1, frames);
+}
+
+int DriverFiscalEpsonExt::window() const
+{
+    return m_window;
 }
 
 void DriverFiscalEpsonExt::run()
 {
+    // frames on the line waiting for their reply, oldest first
+    QList<PackageEpsonExt *> sent;
+    QList<FiscalReply> replies;
+    QList<qint64> sentAt;
+    // ACK owed for the last reply, it goes out in the same write as the next frame
+    QByteArray ack;
+
+    // the worker lives as long as the driver, finish() closes the queue
+    while(m_continue) {
+        bool closed = false;
+        while(sent.size() < m_window) {
+            const bool idle = sent.isEmpty() && ack.isEmpty();
+            PackageEpsonExt *pkg = 0;
+            FiscalReply reply;
+            if(!queue.pop(&pkg, &reply, documentOpen(), idle ? ULONG_MAX : 0)) {
+                // only a blocking pop fails for good, a polling one just found it empty
+                closed = idle;
+                break;
+            }
+
+            pkg->setSecuence(nextSecuence());
+            m_connector->write(ack + pkg->fiscalPackage());
+            ack.clear();
+            sent.append(pkg);
+            replies.append(reply);
+            sentAt.append(clock());
+        }
+
+        if(!ack.isEmpty()) {
+            // nothing to send along with it
+            m_connector->write(ack);
+            ack.clear();
+        }
+
+        if(sent.isEmpty()) {
+            if(closed)
+                break;
+            continue; // the ACK is out, wait for the next command
+        }
 
-    while(!queue.empty() && m_continue) {
-        PackageEpsonExt *pkg = queue.first();
-        m_connector->write(pkg->fiscalPackage());
+        // the printer starts on a frame once it answered the one before,
+        // the time the frame waited on the line is not its own
+        m_readSince = qMax(sentAt.first(), m_lastFrame);
+        QByteArray ret = readData(sent.first()->cmd(), 0);
+        if(!m_continue)
+            break;
 
-        QByteArray ret = readData(pkg->cmd(), 0);
-        if(!ret.isEmpty()) {
-            if(ret.at(0) == PackageFiscal::NAK && m_nak_count <= 3) { // ! NAK
+        if(!ret.isEmpty() && ret.at(0) == PackageFiscal::NAK) {
+            if(m_nak_count <= 3) {
                 m_nak_count++;
 #ifdef DEBUG
                 log << "DriverFiscalEpsonExt::run() -> NAK";
 #endif
-                SleeperThread::msleep(100);
-                continue;
-            }
-
-            if (!processStatus(ret)) {
-                queue.clear();
+                pause(100);
+                // go back N, the printer dropped everything after the bad frame
+                for(int i = 0; i < sent.size(); i++) {
+                    m_connector->write(sent.at(i)->fiscalPackage());
+                    sentAt[i] = clock();
+                }
                 continue;
             }
+            ret.clear();
+        }
 
-            m_nak_count = 0;
-
-            if (pkg->cmd() == CMD_CLOSEFISCALRECEIPT_INVOICE_CN) {
-                emit fiscalReceiptNumber(pkg->id(), getReceiptNumber(ret), 1);
-            } else if (pkg->cmd() == CMD_CLOSEFISCALRECEIPT_INVOICE ||
-                    pkg->cmd() == CMD_CLOSEFISCALRECEIPT_TICKET || pkg->cmd() == CMD_CLOSEDNFH) {
-                emit fiscalReceiptNumber(pkg->id(), getReceiptNumber(ret), 0);
-            } else if (pkg->cmd() == CMD_CONTINUEAUDIT) {
-                QByteArray tmp = ret;
-                tmp.remove(0, 9);
-                tmp.remove(2, tmp.size());
-                if (tmp.toHex() == QByteArray("0000"))
-                    continueAudit();
-                else
-                    closeAudit();
-            } else if (pkg->cmd() == CMD_DOWNLOADREPORTBYNUMBER ||
-                    pkg->cmd() == CMD_DOWNLOADREPORTBYDATE) {
-
-                QByteArray tmp = ret;
-                tmp.remove(0, 13);
-                tmp.remove(tmp.size()-5, tmp.size());
-                emit fiscalData(FiscalPrinter::DownloadReport, tmp.data());
-            } else if (pkg->cmd() == CMD_DOWNLOADCONTINUE) {
-                QByteArray tmp = ret;
-                tmp.remove(0, 13);
-                tmp.remove(tmp.size()-7, tmp.size());
-                emit fiscalData(FiscalPrinter::DownloadContinue, tmp.data());
-            } else if (pkg->cmd() == CMD_DOWNLOADFINALIZE) {
-                emit fiscalData(FiscalPrinter::DownloadFinalize, QVariant());
-            }
-
-
-            queue.pop_front();
-            sendAck();
-            delete pkg;
-
-        } else {
+        if(ret.isEmpty()) {
 #ifdef DEBUG
             log << QString("DriverFiscalEpsonExt::run() -> fiscal error?");
 #endif
-            sendAck();
-            queue.clear();
+            ack.append(PackageFiscal::ACK);
+            replies.first().complete(false);
+            dropSent(&sent, &replies);
+            sentAt.clear();
+            qDeleteAll(queue.takeAll());
+            continue;
         }
-    }
-}
 
-bool DriverFiscalEpsonExt::processStatus(const QByteArray &data)
-{
-    QByteArray tmp = data;
-    tmp.remove(0, 5);
-    tmp.remove(2, tmp.size());
+        // a reply to a frame we are no longer waiting for is only acknowledged
+        ack.append(PackageFiscal::ACK);
+        const int i = indexOfSecuence(sent, m_decoder.sequence());
+        if(i < 0)
+            continue;
 
-    bool ok;
-    const int status = tmp.toHex().toInt(&ok, 16);
+        PackageEpsonExt *pkg = sent.takeAt(i);
+        FiscalReply reply = replies.takeAt(i);
+        sentAt.removeAt(i);
+        m_nak_count = 0;
 
-    if (status & (1 << 11))  { // 11 FISCAL
-        emit fiscalStatus(FiscalPrinter::FullFiscalMemory);
-        return false;
+        if(!processReply(pkg, reply, ret)) {
+            dropSent(&sent, &replies);
+            sentAt.clear();
+            qDeleteAll(queue.takeAll());
+        }
+        delete pkg;
     }
 
-    return true;
+    dropSent(&sent, &replies);
 }
 
-void DriverFiscalEpsonExt::sendAck()
+int DriverFiscalEpsonExt::indexOfSecuence(const QList<PackageEpsonExt *> &sent, const int secuence)
 {
-    QByteArray ack;
-    ack.append(PackageFiscal::ACK);
-    m_connector->write(ack);
-    QByteArray bufferBytes = m_connector->read(1);
-#ifdef DEBUG
-    log << QString("DriverFiscalEpsonExt::sendAck() %1").arg(bufferBytes.toHex().constData());
-#endif
+    for(int i = 0; i < sent.size(); i++) {
+        if(sent.at(i)->secuence() == secuence)
+            return i;
+    }
+    return -1;
 }
 
-int DriverFiscalEpsonExt::getReceiptNumber(const QByteArray &data)
+void DriverFiscalEpsonExt::dropSent(QList<PackageEpsonExt *> *sent, QList<FiscalReply> *replies)
 {
-    QByteArray tmp = data;
-    tmp.remove(0, 13);
-    for(int i = 0; i < tmp.size(); i++) {
-        if(tmp.at(i) == PackageFiscal::FS) {
-            tmp.remove(i, tmp.size());
-            break;
-        }
-    }
+    for(int i = 0; i < replies->size(); i++)
+        (*replies)[i].cancel();
+    qDeleteAll(*sent);
+    sent->clear();
+    replies->clear();
+    // a download in progress went with them
+    m_sink.fetchAndStoreOrdered(0);
+}
 
-#ifdef DEBUG
-    log << QString("DriverFiscalEpsonExt::getReceiptNumber() -> F. Num: %1").arg(tmp.trimmed().toInt());
-#endif
-    return tmp.trimmed().toInt();
+bool DriverFiscalEpsonExt::setDownloadSink(QIODevice *sink)
+{
+    return sink && m_sink.testAndSetOrdered(0, sink);
 }
 
-bool DriverFiscalEpsonExt::getStatus(const QByteArray &data)
+bool DriverFiscalEpsonExt::streamChunk(const QByteArray &chunk, const FiscalReply &reply)
 {
-    QByteArray tmp = data;
-    tmp.remove(0, 11);
-    tmp.remove(5, tmp.size());
+    QIODevice *sink = m_sink.fetchAndAddOrdered(0);
+    if (sink->write(chunk) != chunk.size()) {
+#ifdef DEBUG
+        log << QString("DriverFiscalEpsonExt::streamChunk() -> write failed at %1").arg(m_downloaded);
+#endif
+        // still leave the download mode, nobody waits for the answer
+        pushDownload(CMD_DOWNLOADFINALIZE, FiscalReply(), UrgentLane);
+        return false;
+    }
 
-    return tmp == QByteArray("0000");
+    m_downloaded += chunk.size();
+    emit downloadProgress(m_downloaded);
+
+    const int edge = sizeof(CMS_END) - 2;
+    const bool last = (m_downloadTail + chunk.left(edge)).contains(CMS_END) || chunk.contains(CMS_END);
+    m_downloadTail = chunk.right(edge);
+
+    // straight after this one: the printer is in download mode until finalized
+    pushDownload(last ? CMD_DOWNLOADFINALIZE : CMD_DOWNLOADCONTINUE, reply, UrgentLane);
+    return true;
 }
 
-QByteArray DriverFiscalEpsonExt::readData(const int pkg_cmd, const QByteArray &secuence)
+bool DriverFiscalEpsonExt::processReply(PackageEpsonExt *pkg, FiscalReply &reply, const QByteArray &ret)
 {
-    bool ok = false;
-    int count_tw = 0;
-    QByteArray bytes;
+    int printer, fiscal;
+    statusWords(ret, &printer, &fiscal);
+    reply.setStatus(printer, fiscal);
+    updateStatus(decodeStatus(printer, fiscal), printer, fiscal);
+    if (pkg->cmd() == CMD_STATUS)
+        reply.setValue(status());
+
+    if (!processStatus()) {
+        reply.complete(false, ret);
+        return false;
+    }
 
-    do {
-        if(m_connector->type().compare("COM") == 0  && (m_connector->bytesAvailable() <= 0 && m_continue)) {
-            //log << QString("NB tw");
-            count_tw++;
-            SleeperThread::msleep(100);
+    if (pkg->cmd() == CMD_CLOSEFISCALRECEIPT_INVOICE_CN) {
+        const int number = getReceiptNumber(ret);
+        reply.setValue(number);
+        emit fiscalReceiptNumber(pkg->id(), number, 1);
+    } else if (pkg->cmd() == CMD_CLOSEFISCALRECEIPT_INVOICE ||
+            pkg->cmd() == CMD_CLOSEFISCALRECEIPT_TICKET || pkg->cmd() == CMD_CLOSEDNFH) {
+        const int number = getReceiptNumber(ret);
+        reply.setValue(number);
+        emit fiscalReceiptNumber(pkg->id(), number, 0);
+    } else if (pkg->cmd() == CMD_CONTINUEAUDIT) {
+        const ReplyView view(ret);
+        if (view.size() > 10 && view.binaryWord(9) == 0)
+            continueAudit();
+        else
+            closeAudit();
+    } else if (pkg->cmd() == CMD_DOWNLOADREPORTBYNUMBER ||
+            pkg->cmd() == CMD_DOWNLOADREPORTBYDATE) {
+
+        // one copy straight from the frame, it outlives it in queued slots
+        const QByteArray chunk = ret.mid(13, ret.size() - 13 - 5);
+        if (m_sink.fetchAndAddOrdered(0)) {
+            m_downloaded = 0;
+            m_downloadTail.clear();
+            if (!streamChunk(chunk, reply)) {
+                reply.complete(false, ret);
+                return true;
+            }
+        } else {
+            reply.setValue(chunk);
+            // fiscalData keeps carrying it as a QString, reply.value() has the bytes
+            emit fiscalData(FiscalPrinter::DownloadReport, chunk.constData());
+        }
+    } else if (pkg->cmd() == CMD_DOWNLOADCONTINUE) {
+        const QByteArray chunk = ret.mid(13, ret.size() - 13 - 7);
+        if (m_sink.fetchAndAddOrdered(0)) {
+            if (!streamChunk(chunk, reply)) {
+                reply.complete(false, ret);
+                return true;
+            }
+        } else {
+            reply.setValue(chunk);
+            emit fiscalData(FiscalPrinter::DownloadContinue, chunk.constData());
         }
+    } else if (pkg->cmd() == CMD_DOWNLOADFINALIZE) {
+        if (m_sink.fetchAndStoreOrdered(0))
+            reply.setValue(m_downloaded);
+        emit fiscalData(FiscalPrinter::DownloadFinalize, QVariant());
+    }
 
-        if(!m_continue)
-            return "";
-
-        QByteArray bufferBytes = m_connector->read(1);
-        if(bufferBytes.at(0) == PackageFiscal::DC1 || bufferBytes.at(0) == PackageFiscal::DC2
-                || bufferBytes.at(0) == PackageFiscal::DC3 || bufferBytes.at(0) == PackageFiscal::DC4
-                || bufferBytes.at(0) == PackageFiscal::FNU || bufferBytes.at(0) == PackageFiscal::ACK) {
-            SleeperThread::msleep(100);
-            //count_tw -= 20;
-            continue;
-        } else if(bufferBytes.at(0) == PackageFiscal::NAK) {
-            return bufferBytes;
-        } else if(bufferBytes.at(0) == PackageFiscal::STX) {
-            bufferBytes = m_connector->read(1);
-            verifyIntermediatePackage(bufferBytes);
+    reply.complete(true, ret);
+    return true;
+}
 
+bool DriverFiscalEpsonExt::processStatus()
+{
+    if (status() & FiscalPrinter::FiscalMemoryFull) {
+        emit fiscalStatus(FiscalPrinter::FullFiscalMemory);
+        return false;
+    }
 
-            bytes += PackageFiscal::STX;
+    return true;
+}
+
+void DriverFiscalEpsonExt::statusWords(const QByteArray &data, int *printer, int *fiscal)
+{
+    // STX SEQ CMD CMD FS PP FS FF, binary big endian words
+    const ReplyView reply(data);
+    *printer = reply.binaryWord(5);
+    *fiscal = reply.binaryWord(8);
+}
 
-            while(bufferBytes.at(0) != PackageFiscal::ETX) {
+int DriverFiscalEpsonExt::decodeStatus(const int printer, const int fiscal)
+{
+    int status = 0;
 
-                if(count_tw >= MAX_TW)
-                    break;
+    if (printer & (1 << 11)) // 11 FISCAL
+        status |= FiscalPrinter::FiscalMemoryFull;
 
-                if(bufferBytes.isEmpty()) {
-                    SleeperThread::msleep(100);
-                    count_tw++;
-                } else {
-                    if (count_tw > 100)
-                        count_tw -= 20;
-                }
+    // bits 12-15 of the fiscal word: the kind of document in progress, 0 for
+    // none. Lanes keep control commands out of an open one.
+    if ((fiscal >> 12) & 0x0f)
+        status |= FiscalPrinter::DocumentOpen;
 
-                if(bufferBytes.at(0) == PackageFiscal::STX) {
-                    bufferBytes = m_connector->read(1);
-                    verifyIntermediatePackage(bufferBytes);
-                }
-                bytes += bufferBytes;
-                bufferBytes = m_connector->read(1);
+    return status;
+}
 
-            }
+int DriverFiscalEpsonExt::getReceiptNumber(const QByteArray &data)
+{
+    const ReplyView reply(data);
+    const int fs = reply.indexOf(PackageFiscal::FS, 13);
+    const int number = ReplyView::toInt(reply.mid(13, fs < 0 ? -1 : fs - 13));
 
-            bytes += PackageFiscal::ETX;
-
-            QByteArray checkSumArray;
-            int checksumCount = 0;
-            while(checksumCount != 4 && m_continue) {
-                checkSumArray = m_connector->read(1);
-                if(checkSumArray.isEmpty()) {
-                    SleeperThread::msleep(100);
-                    count_tw++;
-                } else {
-                    if (count_tw > 100)
-                        count_tw -= 20;
-
-                    checksumCount++;
-                    bytes += checkSumArray;
-                }
+#ifdef DEBUG
+    log << QString("DriverFiscalEpsonExt::getReceiptNumber() -> F. Num: %1").arg(number);
+#endif
+    return number;
+}
 
-                if(count_tw >= MAX_TW)
-                    break;
-            }
+bool DriverFiscalEpsonExt::getStatus(const QByteArray &data)
+{
+    return ReplyView(data).mid(11, 5) == "0000";
+}
 
-            ok = true;
-            break;
-        } else {
-            verifyIntermediatePackage(bufferBytes);
-            bytes += bufferBytes;
-        }
+QByteArray DriverFiscalEpsonExt::readData(const int pkg_cmd, const QByteArray &secuence)
+{
+    // intermediate 0x80 frames are consumed by the decoder
+    const FrameDecoder::Event event = readFrame(pkg_cmd, m_readSince);
 
-        if (bufferBytes.isEmpty())
-            count_tw++;
+    if(!m_continue)
+        return "";
 
-    } while(ok != true && count_tw <= MAX_TW && m_continue);
+    if(event == FrameDecoder::Nak)
+        return QByteArray(1, PackageFiscal::NAK);
 
-#ifdef DEBUG
-    log << QString("DriverFiscalEpsonExt::readData() -> counter: %1 %2").arg(count_tw).arg(MAX_TW);
-#endif
+    QByteArray bytes;
+    if(event == FrameDecoder::Frame)
+        bytes = m_decoder.frame();
 
-    ok = verifyResponse(bytes, pkg_cmd);
+    const bool ok = verifyResponse(bytes, pkg_cmd);
 
     if(!ok) {
+        reportOk(false, false);
 #ifdef DEBUG
         log << QString("DriverFiscalEpsonExt::readData() -> error read: %1").arg(bytes.toHex().data());
 #endif
@@ -299,49 +404,13 @@ QByteArray DriverFiscalEpsonExt::readData(const int pkg_cmd, const QByteArray &s
 #ifdef DEBUG
         log << QString("DriverFiscalEpsonExt::readData() -> OK PKGV3: %1").arg(bytes.toHex().data());
 #endif
-        emit fiscalStatus(FiscalPrinter::Ok);
+        if(reportOk(true, pkg_cmd == CMD_STATUS))
+            emit fiscalStatus(FiscalPrinter::Ok);
     }
 
     return bytes;
 }
 
-void DriverFiscalEpsonExt::verifyIntermediatePackage(QByteArray &bufferBytes)
-{
-    if (QString(bufferBytes.toHex()) != "80")
-        return;
-
-    int count_tw = 0;
-    while (QString(bufferBytes.toHex()) == "80") {
-        count_tw++;
-
-        bufferBytes = m_connector->read(1);
-        while(bufferBytes.at(0) != PackageFiscal::ETX) {
-            bufferBytes = m_connector->read(1);
-            count_tw++;
-            if(count_tw >= MAX_TW)
-                break;
-        }
-
-        bufferBytes.clear();
-
-        QByteArray checkSumArray;
-        int checksumCount = 0;
-        while(checksumCount != 4 && m_continue) {
-            checkSumArray = m_connector->read(1);
-            count_tw++;
-            if(checkSumArray.isEmpty()) {
-                SleeperThread::msleep(100);
-            } else {
-                checksumCount++;
-            }
-
-            if(count_tw >= MAX_TW)
-                break;
-        }
-    }
-
-}
-
 bool DriverFiscalEpsonExt::verifyResponse(const QByteArray &bytes, const int pkg_cmd)
 {
     if(bytes.at(0) != PackageFiscal::STX) {
@@ -447,8 +516,7 @@ void DriverFiscalEpsonExt::statusRequest()
 
     p->setData(d);
 
-    queue.append(p);
-    start();
+    queue.push(p, FiscalReply(), ControlLane);
 }
 
 void DriverFiscalEpsonExt::dailyClose(const char type)
@@ -477,8 +545,7 @@ void DriverFiscalEpsonExt::dailyClose(const char type)
 
     p->setData(d);
 
-    queue.append(p);
-    start();
+    queue.push(p);
 }
 
 void DriverFiscalEpsonExt::dailyCloseByDate(const QDate &from, const QDate &to)
@@ -499,8 +566,7 @@ void DriverFiscalEpsonExt::dailyCloseByDate(const QDate &from, const QDate &to)
     d.append(to.toString("ddMMyy"));
     p->setData(d);
 
-    queue.append(p);
-    start();
+    queue.push(p);
 
     continueAudit();
 }
@@ -524,8 +590,7 @@ void DriverFiscalEpsonExt::dailyCloseByNumber(const int from, const int to)
     p->setData(d);
 
 
-    queue.append(p);
-    start();
+    queue.push(p);
 
     continueAudit();
     // for (int i = 0; i <= (to - from); i++)
@@ -547,8 +612,7 @@ void DriverFiscalEpsonExt::continueAudit()
     d.append(QByteArray::fromHex("0"));
     p->setData(d);
 
-    queue.append(p);
-    start();
+    queue.push(p);
 
 }
 
@@ -566,8 +630,7 @@ void DriverFiscalEpsonExt::closeAudit()
     d.append(QByteArray::fromHex("0"));
     p->setData(d);
 
-    queue.append(p);
-    start();
+    queue.push(p);
 
 }
 
@@ -644,8 +707,7 @@ void DriverFiscalEpsonExt::openFiscalReceipt(const char type)
 
     p->setData(d);
 
-    queue.append(p);
-    start();
+    queue.push(p);
 }
 
 void DriverFiscalEpsonExt::printFiscalText(const QString &text)
@@ -713,8 +775,7 @@ void DriverFiscalEpsonExt::printLineItem(const QString &description, const qreal
     d.append(PackageFiscal::FS);
     p->setData(d);
 
-    queue.append(p);
-    start();
+    queue.push(p);
 
 }
 
@@ -744,8 +805,7 @@ void DriverFiscalEpsonExt::perceptions(const QString &desc, qreal tax_amount)
     d.append("2100");
     p->setData(d);
 
-    queue.append(p);
-    start();
+    queue.push(p);
 }
 
 void DriverFiscalEpsonExt::subtotal(const char print)
@@ -774,8 +834,7 @@ void DriverFiscalEpsonExt::subtotal(const char print)
 
     p->setData(d);
 
-    queue.append(p);
-    start();
+    queue.push(p);
 }
 
 void DriverFiscalEpsonExt::totalTender(const QString &description, const qreal amount, const char type)
@@ -827,8 +886,7 @@ void DriverFiscalEpsonExt::totalTender(const QString &description, const qreal a
 
     p->setData(d);
 
-    queue.append(p);
-    start();
+    queue.push(p);
 }
 
 void DriverFiscalEpsonExt::generalDiscount(const QString &description, const qreal amount, const qreal tax_percent, const char type)
@@ -875,8 +933,7 @@ void DriverFiscalEpsonExt::generalDiscount(const QString &description, const qre
     d.append(PackageFiscal::FS);
 
     p->setData(d);
-    queue.append(p);
-    start();
+    queue.push(p);
 }
 
 void DriverFiscalEpsonExt::closeFiscalReceipt(const char intype, const char type, const int id)
@@ -918,8 +975,7 @@ void DriverFiscalEpsonExt::closeFiscalReceipt(const char intype, const char type
     clear();
 
     p->setData(d);
-    queue.append(p);
-    start();
+    queue.push(p);
 
 }
 
@@ -939,12 +995,13 @@ void DriverFiscalEpsonExt::openNonFiscalReceipt()
 
     p->setData(d);
 
-    queue.append(p);
-    start();
+    queue.push(p);
 }
 
 void DriverFiscalEpsonExt::printNonFiscalText(const QString &text)
 {
+    QList<PackageEpsonExt *> batch;
+
     QString t = text;
     while(!t.isEmpty()) {
         PackageEpsonExt *p = new PackageEpsonExt;
@@ -965,10 +1022,10 @@ void DriverFiscalEpsonExt::printNonFiscalText(const QString &text)
 
         t.remove(0, 40);
 
-        queue.append(p);
+        batch.append(p);
     }
 
-    start();
+    queue.push(batch);
 }
 
 void DriverFiscalEpsonExt::closeNonFiscalReceipt()
@@ -992,8 +1049,7 @@ void DriverFiscalEpsonExt::closeNonFiscalReceipt()
     d.append(PackageFiscal::FS);
     p->setData(d);
 
-    queue.append(p);
-    start();
+    queue.push(p);
 }
 
 void DriverFiscalEpsonExt::openDrawer()
@@ -1010,8 +1066,7 @@ void DriverFiscalEpsonExt::openDrawer()
     d.append(0x01);
     p->setData(d);
 
-    queue.append(p);
-    start();
+    queue.push(p, FiscalReply(), ControlLane);
 }
 
 void DriverFiscalEpsonExt::setHeaderTrailer(const QString &header, const QString &trailer)
@@ -1078,8 +1133,7 @@ void DriverFiscalEpsonExt::openDNFH(const char type, const char fix_value, const
 
     p->setData(d);
 
-    queue.append(p);
-    start();
+    queue.push(p);
 }
 
 void DriverFiscalEpsonExt::printEmbarkItem(const QString &description, const qreal quantity)
@@ -1114,14 +1168,19 @@ void DriverFiscalEpsonExt::closeDNFH(const int id, const char f_type, const int
 
     p->setData(d);
 
-    queue.append(p);
-    start();
+    queue.push(p);
 }
 
 void DriverFiscalEpsonExt::cancel()
 {
 }
 
+bool DriverFiscalEpsonExt::canVoid()
+{
+    // no cancel frame is known for the TM-900 yet
+    return false;
+}
+
 void DriverFiscalEpsonExt::ack()
 {
 }
@@ -1146,9 +1205,7 @@ void DriverFiscalEpsonExt::setDateTime(const QDateTime &dateTime)
     d.append(dateTime.toString("hhmmss"));
 
     p->setData(d);
-    queue.append(p);
-
-    start();
+    queue.push(p);
 }
 
 void DriverFiscalEpsonExt::setFooter(int line, const QString &text)
@@ -1171,9 +1228,7 @@ void DriverFiscalEpsonExt::setFooter(int line, const QString &text)
     d.append(text);
 
     p->setData(d);
-    queue.append(p);
-
-    start();
+    queue.push(p);
 }
 
 void DriverFiscalEpsonExt::clear()
@@ -1214,9 +1269,7 @@ void DriverFiscalEpsonExt::reprintDocument(const QString &doc_type, const int do
     d.append(QString::number(doc_number));
 
     p->setData(d);
-    queue.append(p);
-
-    start();
+    queue.push(p);
 }
 
 void DriverFiscalEpsonExt::reprintContinue()
@@ -1234,9 +1287,7 @@ void DriverFiscalEpsonExt::reprintContinue()
     d.append(QByteArray::fromHex("0"));
 
     p->setData(d);
-    queue.append(p);
-
-    start();
+    queue.push(p);
 }
 
 void DriverFiscalEpsonExt::reprintFinalize()
@@ -1254,9 +1305,7 @@ void DriverFiscalEpsonExt::reprintFinalize()
     d.append(QByteArray::fromHex("0"));
 
     p->setData(d);
-    queue.append(p);
-
-    start();
+    queue.push(p);
 }
 
 void DriverFiscalEpsonExt::setFixedData(const QString &shop, const QString &phone)
@@ -1289,9 +1338,7 @@ void DriverFiscalEpsonExt::getTransactionalMemoryInfo()
     d.append(QByteArray::fromHex("0"));
 
     p->setData(d);
-    queue.append(p);
-
-    start();
+    queue.push(p);
 }
 
 void DriverFiscalEpsonExt::downloadReportByDate(const QString &type, const QDate &from, const QDate &to)
@@ -1317,8 +1364,7 @@ void DriverFiscalEpsonExt::downloadReportByDate(const QString &type, const QDate
     d.append(to.toString("ddMMyy"));
     p->setData(d);
 
-    queue.append(p);
-    start();
+    queue.push(p);
 }
 
 void DriverFiscalEpsonExt::downloadReportByNumber(const QString &type, const int from, const int to)
@@ -1344,48 +1390,35 @@ void DriverFiscalEpsonExt::downloadReportByNumber(const QString &type, const int
     d.append(QString::number(to));
     p->setData(d);
 
-    queue.append(p);
-    start();
+    queue.push(p);
 }
 
 void DriverFiscalEpsonExt::downloadContinue()
 {
-    PackageEpsonExt *p = new PackageEpsonExt;
-    p->setCmd(CMD_DOWNLOADCONTINUE);
-
-    QByteArray d;
-    // CMD
-    d.append(0x09);
-    d.append(0x70);
-    // DATA
-    d.append(PackageFiscal::FS);
-    d.append(QByteArray::fromHex("0"));
-    d.append(QByteArray::fromHex("0"));
-
-    p->setData(d);
-    queue.append(p);
-
-    start();
+    pushDownload(CMD_DOWNLOADCONTINUE, FiscalReply(), NormalLane);
 }
 
 void DriverFiscalEpsonExt::downloadFinalize()
+{
+    pushDownload(CMD_DOWNLOADFINALIZE, FiscalReply(), NormalLane);
+}
+
+void DriverFiscalEpsonExt::pushDownload(const int cmd, const FiscalReply &reply, const CommandLane lane)
 {
     PackageEpsonExt *p = new PackageEpsonExt;
-    p->setCmd(CMD_DOWNLOADFINALIZE);
+    p->setCmd(cmd);
 
     QByteArray d;
     // CMD
     d.append(0x09);
-    d.append(0x71);
+    d.append(cmd == CMD_DOWNLOADCONTINUE ? 0x70 : 0x71);
     // DATA
     d.append(PackageFiscal::FS);
     d.append(QByteArray::fromHex("0"));
     d.append(QByteArray::fromHex("0"));
 
     p->setData(d);
-    queue.append(p);
-
-    start();
+    queue.push(p, reply, lane);
 }
 
 void DriverFiscalEpsonExt::downloadDelete(const int to)
@@ -1405,7 +1438,5 @@ void DriverFiscalEpsonExt::downloadDelete(const int to)
     d.append(QString::number(to));
 
     p->setData(d);
-    queue.append(p);
-
-    start();
+    queue.push(p);
 }
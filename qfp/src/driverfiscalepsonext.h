@@ -35,6 +35,8 @@
 #ifndef DRIVERFISCALEPSONEXT_H
 #define DRIVERFISCALEPSONEXT_H
 
+#include <QAtomicPointer>
+
 #include "driverfiscal.h"
 #include "packageepsonext.h"
 #include "fiscalprinter.h"
@@ -74,6 +76,9 @@ public:
     };
 
     void setModel(const FiscalPrinter::Model model);
+    // frames sent ahead without waiting for the previous reply, 1 is stop and wait
+    void setWindow(const int frames);
+    int window() const;
 
     virtual QByteArray readData(const int pkg_cmd, const QByteArray &secuence);
     virtual int getReceiptNumber(const QByteArray &data);
@@ -110,10 +115,15 @@ public:
     virtual void reprintContinue();
     virtual void reprintFinalize();
     virtual void cancel();
+    virtual bool canVoid();
     virtual void ack();
     virtual void setDateTime(const QDateTime &dateTime);
     virtual void setFixedData(const QString &shop, const QString &phone);
     virtual void finish();
+    virtual int queueDepth();
+    virtual void beginBatch(const FiscalReply &reply = FiscalReply());
+    virtual void endBatch();
+    virtual void statusWords(const QByteArray &data, int *printer, int *fiscal);
 
     virtual void getTransactionalMemoryInfo();
     virtual void downloadReportByDate(const QString &type, const QDate &form, const QDate &to);
@@ -121,29 +131,43 @@ public:
     virtual void downloadContinue();
     virtual void downloadFinalize();
     virtual void downloadDelete(const int to);
+    virtual bool setDownloadSink(QIODevice *sink);
 
 signals:
     void fiscalReceiptNumber(int id, int number, int type); // type == 0 Factura, == 1 NC
     void fiscalStatus(int state);
     void fiscalData(int cmd, QVariant data);
+    void statusChanged(int status, int changed);
+    void downloadProgress(qint64 bytes);
 
 protected:
     void run();
+    virtual int decodeStatus(const int printer, const int fiscal);
 
 private:
+    int nextSecuence();
     bool m_error;
     bool m_isinvoice;
     bool m_iscreditnote;
-    QVector<PackageEpsonExt *> queue;
+    CommandQueue<PackageEpsonExt *> queue;
     FiscalPrinter::Model m_model;
     int m_nak_count;
+    qint64 m_readSince; // clock() the frame being read started at
+    int m_secuence;
+    int m_window;
+    QAtomicPointer<QIODevice> m_sink; // set by the caller, cleared by the worker
+    qint64 m_downloaded;
+    QByteArray m_downloadTail; // end of the last chunk, the end marker may straddle two
 
     void clear();
-    void sendAck();
-    void verifyIntermediatePackage(QByteArray &bufferBytes);
+    bool processReply(PackageEpsonExt *pkg, FiscalReply &reply, const QByteArray &ret);
+    int indexOfSecuence(const QList<PackageEpsonExt *> &sent, const int secuence);
+    void dropSent(QList<PackageEpsonExt *> *sent, QList<FiscalReply> *replies);
+    void pushDownload(const int cmd, const FiscalReply &reply, const CommandLane lane);
+    bool streamChunk(const QByteArray &chunk, const FiscalReply &reply);
     void setFooter(int line, const QString &text);
     bool checkSum(const QByteArray &data);
-    bool processStatus(const QByteArray &data);
+    bool processStatus();
     void continueAudit();
     void closeAudit();
     QString m_name;
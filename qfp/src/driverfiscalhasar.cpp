@@ -33,14 +33,14 @@
 */
 
 #include "driverfiscalhasar.h"
+#include "commandjournal.h"
 #include "packagefiscal.h"
+#include "replyview.h"
 #include "logger.h"
 
 #include <QCoreApplication>
 #include <QDateTime>
 
-int PackageHasar::m_secuence = 0x20;
-
 DriverFiscalHasar::DriverFiscalHasar(QObject *parent, Connector *m_connector, int m_TIME_WAIT)
     : QThread(parent), DriverFiscal(parent, m_connector, m_TIME_WAIT)
 {
@@ -48,9 +48,13 @@ DriverFiscalHasar::DriverFiscalHasar(QObject *parent, Connector *m_connector, in
     //Logger::instance()->init(QCoreApplication::applicationDirPath() + "/fiscal.txt");
 #endif
     m_nak_count = 0;
+    m_secuence = 0x20;
+    m_journal = 0;
+    m_recover = false;
     m_error = false;
     errorHandler_count = 0;
     m_continue = true;
+    start();
 }
 
 void DriverFiscalHasar::setModel(const FiscalPrinter::Model model)
@@ -60,29 +64,68 @@ void DriverFiscalHasar::setModel(const FiscalPrinter::Model model)
 
 void DriverFiscalHasar::finish()
 {
-    m_continue = false;
-    queue.clear();
-    quit();
+    interrupt();
+    qDeleteAll(queue.takeAll());
+    queue.close();
+    wait();
+}
 
-    while(isRunning()) {
-        msleep(100);
-        quit();
-    }
+int DriverFiscalHasar::queueDepth()
+{
+    return queue.size();
+}
+
+void DriverFiscalHasar::beginBatch(const FiscalReply &reply)
+{
+    queue.beginBatch(reply);
+}
+
+void DriverFiscalHasar::endBatch()
+{
+    queue.endBatch();
+}
+
+int DriverFiscalHasar::nextSecuence()
+{
+    const int secuence = m_secuence;
+    if(++m_secuence >= 0x7f)
+        m_secuence = 0x20;
+    return secuence;
 }
 
 void DriverFiscalHasar::run()
 {
-    while(!queue.empty() && m_continue) {
-        PackageHasar *pkg = queue.first();
+    PackageHasar *pkg = 0;
+    FiscalReply reply;
+
+    // the worker lives as long as the driver, finish() closes the queue
+    while(m_continue) {
+        if(!pkg) {
+            if(!queue.pop(&pkg, &reply, documentOpen()))
+                break;
+            if(m_recover) {
+                m_recover = false;
+                recover();
+            }
+            pkg->setSecuence(nextSecuence());
+            if(m_journal)
+                journalQueued(pkg);
+        }
+
         m_connector->write(pkg->fiscalPackage());
 
         QByteArray ret = readData(pkg->cmd(), 0);
         if(ret == "-1") {
-            queue.clear();
+            journalAcked(pkg->cmd(), false);
+            reply.complete(false);
+            delete pkg;
+            pkg = 0;
+            qDeleteAll(queue.takeAll());
             m_connector->readAll();
 
+            // give up on recovering, but keep serving new commands
             if(errorHandler_count > 4)
-                return;
+                continue;
 
             errorHandler_count++;
 
@@ -90,12 +133,16 @@ void DriverFiscalHasar::run()
             for(int i = 0 ; i < 100; i++)
                 sendAck();*/
 
-            errorHandler();
+            // with a journal the open document is known, no need to guess
+            if(m_journal)
+                recover();
+            else
+                errorHandler();
 
         } else if(!ret.isEmpty()) {
             if(ret.at(0) == PackageFiscal::NAK && m_nak_count <= 3) { // ! NAK
                 m_nak_count++;
-                SleeperThread::msleep(100);
+                pause(100);
                 continue;
             }
 
@@ -103,18 +150,32 @@ void DriverFiscalHasar::run()
             errorHandler_count = 0;
 
             sendAck();
+            journalAcked(pkg->cmd(), true);
+
+            int printer, fiscal;
+            statusWords(ret, &printer, &fiscal);
+            reply.setStatus(printer, fiscal);
+            updateStatus(decodeStatus(printer, fiscal), printer, fiscal);
+            if(pkg->cmd() == CMD_STATUS)
+                reply.setValue(status());
 
             if(pkg->cmd() == CMD_CLOSEFISCALRECEIPT || pkg->cmd() == CMD_CLOSEDNFH) {
-                emit fiscalReceiptNumber(pkg->id(), getReceiptNumber(ret), pkg->ftype());
+                const int number = getReceiptNumber(ret);
+                reply.setValue(number);
+                emit fiscalReceiptNumber(pkg->id(), number, pkg->ftype());
             }
 
-            queue.pop_front();
+            reply.complete(true, ret);
             delete pkg;
+            pkg = 0;
 
         } else {
 
             sendAck();
-            queue.clear();
+            reply.complete(false);
+            delete pkg;
+            pkg = 0;
+            qDeleteAll(queue.takeAll());
             /*
             if(m_nak_count <= 3) {
                 m_nak_count++;
@@ -125,6 +186,9 @@ void DriverFiscalHasar::run()
         }
 
     }
+
+    reply.cancel();
+    delete pkg;
 }
 
 void DriverFiscalHasar::errorHandler()
@@ -147,6 +211,7 @@ void DriverFiscalHasar::errorHandler()
         d.append("0");
     }
     p->setData(d);
+    p->setSecuence(nextSecuence());
     m_connector->write(p->fiscalPackage());
 
 
@@ -157,6 +222,7 @@ void DriverFiscalHasar::errorHandler()
     p->setCmd(CMD_CLOSEFISCALRECEIPT);
     p->setFtype(0);
     p->setId(-1);
+    p->setSecuence(nextSecuence());
     m_connector->write(p->fiscalPackage());
 
     delete p;
@@ -167,17 +233,114 @@ void DriverFiscalHasar::errorHandler()
 
     QByteArray z;
     p->setData(z);
+    p->setSecuence(nextSecuence());
     m_connector->write(p->fiscalPackage());
 
     delete p;
     sendAck();
 
 
-    SleeperThread::msleep(200);
+    pause(200);
     statusRequest();
 
 }
 
+bool DriverFiscalHasar::setJournal(CommandJournal *journal)
+{
+    m_journal = journal;
+    if(m_journal->inDocument()) {
+        m_recover = true;
+        // wakes up the worker, the recovery goes before any other command
+        statusRequest();
+    }
+    return true;
+}
+
+void DriverFiscalHasar::journalQueued(PackageHasar *p)
+{
+    const int cmd = p->cmd();
+    if(cmd == CMD_OPENFISCALRECEIPT || cmd == CMD_OPENNONFISCALRECEIPT || cmd == CMD_OPENDNFH)
+        m_journal->begin(cmd);
+    m_journal->queued(cmd, p->fiscalPackage());
+}
+
+void DriverFiscalHasar::journalAcked(const int cmd, const bool ok)
+{
+    if(!m_journal)
+        return;
+
+    m_journal->acked(cmd, ok);
+    if(ok && (cmd == CMD_CLOSEFISCALRECEIPT || cmd == CMD_CLOSENONFISCALRECEIPT
+            || cmd == CMD_CLOSEDNFH || cmd == CMD_CANCEL))
+        m_journal->end();
+}
+
+bool DriverFiscalHasar::transact(PackageHasar *p)
+{
+    p->setSecuence(nextSecuence());
+    m_connector->write(p->fiscalPackage());
+    const QByteArray ret = readData(p->cmd(), 0);
+    sendAck();
+    if(ret.isEmpty() || ret == "-1" || ret.at(0) == PackageFiscal::NAK)
+        return false;
+
+    int printer, fiscal;
+    statusWords(ret, &printer, &fiscal);
+    updateStatus(decodeStatus(printer, fiscal), printer, fiscal);
+    return true;
+}
+
+void DriverFiscalHasar::recover()
+{
+    const QList<CommandJournal::Record> records = m_journal->pending();
+    if(records.isEmpty())
+        return;
+
+    const CommandJournal::Record &last = records.last();
+#ifdef DEBUG
+    log << QString("DriverFiscalHasar::recover() -> %1 records, last cmd 0x%2 type %3")
+           .arg(records.size()).arg(last.cmd, 0, 16).arg(last.type);
+#endif
+
+    m_connector->readAll();
+
+    // Stop-and-wait leaves at most the last frame without an answer. Sent
+    // again byte for byte, same sequence, a printer that already ran it
+    // only repeats the answer.
+    if(last.type == CommandJournal::Queued && last.data.size() > 1) {
+        m_secuence = static_cast<unsigned char>(last.data.at(1));
+        nextSecuence();
+        m_connector->write(last.data);
+        const QByteArray ret = readData(last.cmd, 0);
+        sendAck();
+        const bool ok = !ret.isEmpty() && ret != "-1" && ret.at(0) != PackageFiscal::NAK;
+        journalAcked(last.cmd, ok);
+        if(!m_journal->inDocument())
+            return; // that was the close
+    }
+
+    // what the POS had not queued yet died with it, the printer tells
+    // whether the document is still open
+    PackageHasar status;
+    status.setCmd(CMD_STATUS);
+    if(!transact(&status))
+        return; // printer unreachable, try again on the next error or run
+
+    if(documentOpen()) {
+        PackageHasar p;
+        // a non fiscal document can't be voided, only closed
+        p.setCmd(records.first().cmd == CMD_OPENNONFISCALRECEIPT
+                ? int(CMD_CLOSENONFISCALRECEIPT) : int(CMD_CANCEL));
+#ifdef DEBUG
+        log << QString("DriverFiscalHasar::recover() -> closing with 0x%1").arg(p.cmd(), 0, 16);
+#endif
+        if(!transact(&p))
+            return;
+    }
+
+    m_journal->end();
+}
+
 void DriverFiscalHasar::sendAck()
 {
 #ifdef DEBUG
@@ -189,119 +352,67 @@ void DriverFiscalHasar::sendAck()
     m_connector->write(ack);
 }
 
+int DriverFiscalHasar::decodeStatus(const int printer, const int fiscal)
+{
+    int status = 0;
+
+    if(printer & (1 << 2))
+        status |= FiscalPrinter::PrinterError;
+    if(printer & (1 << 3))
+        status |= FiscalPrinter::PrinterOffline;
+    // Hasar warns of paper running low, an empty roll shows as offline
+    if(printer & ((1 << 4) | (1 << 5))) // journal, receipt
+        status |= FiscalPrinter::PaperLow;
+    if(printer & (1 << 8))
+        status |= FiscalPrinter::CoverOpen;
+    // set while the drawer is closed or there is none
+    if(!(printer & (1 << 14)))
+        status |= FiscalPrinter::DrawerOpen;
+
+    // the fiscal word is laid out as the Epson one
+    return status | DriverFiscal::decodeStatus(0, fiscal);
+}
+
 int DriverFiscalHasar::getReceiptNumber(const QByteArray &data)
 {
-    QByteArray tmp = data;
-    tmp.remove(0, 14);
-    for(int i = 0; i < tmp.size(); i++) {
-        if(m_model == FiscalPrinter::Hasar330F) {
-            if(tmp.at(i) == PackageFiscal::FS) {
-                tmp.remove(i, tmp.size());
-                break;
-            }
-        } else {
-            if(tmp.at(i) == PackageFiscal::ETX) {
-                tmp.remove(i, tmp.size());
-                break;
-            }
-        }
-    }
+    // the 330F appends more fields after the number
+    const ReplyView reply(data);
+    const int number = ReplyView::toInt(m_model == FiscalPrinter::Hasar330F
+            ? reply.field(3) : reply.mid(14));
 
 #ifdef DEBUG
-    log << QString("F. Num: %1").arg(tmp.trimmed().toInt());
+    log << QString("F. Num: %1").arg(number);
 #endif
-    return tmp.trimmed().toInt();
+    return number;
 }
 
 bool DriverFiscalHasar::getStatus(const QByteArray &data)
 {
-    QByteArray tmp = data;
-    tmp.remove(0, 11);
-    tmp.remove(5, tmp.size());
-
-    return tmp == QByteArray("0000");
+    return ReplyView(data).mid(11, 5) == "0000";
 }
 
 QByteArray DriverFiscalHasar::readData(const int pkg_cmd, const QByteArray &secuence)
 {
-    bool ok = false;
-    int count_tw = 0;
-    QByteArray bytes;
+    const FrameDecoder::Event event = readFrame(pkg_cmd);
 
-    do {
-        if(m_connector->bytesAvailable() <= 0 && m_continue) {
-//            qDebug() << "NB tw";
-            SleeperThread::msleep(100);
-        }
+    if(!m_continue)
+        return "";
 
-        if(!m_continue)
-            return "";
-
-        QByteArray bufferBytes = m_connector->read(1);
-        if(bufferBytes.at(0) == PackageFiscal::ACK) {
-            SleeperThread::msleep(100);
-        } else if(bufferBytes.at(0) == PackageFiscal::DC1 || bufferBytes.at(0) == PackageFiscal::DC2
-                || bufferBytes.at(0) == PackageFiscal::DC3 || bufferBytes.at(0) == PackageFiscal::DC4
-                || bufferBytes.at(0) == PackageFiscal::ACK) {
-            SleeperThread::msleep(100);
-            count_tw -= 30;
-            continue;
-        } else if(bufferBytes.at(0) == PackageFiscal::NAK) {
+    if(event == FrameDecoder::Nak) {
 #ifdef DEBUG
-            log << QString("NAK");
+        log << QString("NAK");
 #endif
-            return bufferBytes;
-        } else if(bufferBytes.at(0) == PackageFiscal::STX) {
-            bytes += PackageFiscal::STX;
-
-            bufferBytes = m_connector->read(1);
-            while(bufferBytes.at(0) != PackageFiscal::ETX) {
-                count_tw++;
-                if(bufferBytes.isEmpty()) {
-                    SleeperThread::msleep(100);
-                }
-
-                bytes += bufferBytes;
-                bufferBytes = m_connector->read(1);
-
-                if(count_tw >= MAX_TW)
-                    break;
-            }
-
-            bytes += PackageFiscal::ETX;
-
-            QByteArray checkSumArray;
-            int checksumCount = 0;
-            while(checksumCount != 4) {
-                checkSumArray = m_connector->read(1);
-                count_tw++;
-                if(checkSumArray.isEmpty()) {
-                    SleeperThread::msleep(100);
-                } else {
-                    checksumCount++;
-                    bytes += checkSumArray;
-                }
-
-                if(count_tw >= MAX_TW)
-                    break;
-            }
-
-            ok = true;
-            break;
-        } else {
-            bytes += bufferBytes;
-        }
-        count_tw++;
-
-    } while(ok != true && count_tw <= MAX_TW && m_continue);
+        return QByteArray(1, PackageFiscal::NAK);
+    }
 
-#ifdef DEBUG
-    log << QString("DriverFiscalHasar::readData() -> counter:  %1 %2").arg(count_tw).arg(MAX_TW);
-#endif
+    QByteArray bytes;
+    if(event == FrameDecoder::Frame)
+        bytes = m_decoder.frame();
 
-    ok = verifyResponse(bytes, pkg_cmd);
+    const bool ok = verifyResponse(bytes, pkg_cmd);
 
     if(!ok) {
+        reportOk(false, false);
 #ifdef DEBUG
         log << QString("DriverFiscalHasar::readData() -> error : %1").arg(bytes.toHex().data());
 #endif
@@ -317,7 +428,8 @@ QByteArray DriverFiscalHasar::readData(const int pkg_cmd, const QByteArray &secu
 #ifdef DEBUG
         log << QString("DriverFiscalHasar::readData() -> OK PGV3: %1").arg(bytes.toHex().data());
 #endif
-        emit fiscalStatus(FiscalPrinter::Ok);
+        if(reportOk(true, pkg_cmd == CMD_STATUS))
+            emit fiscalStatus(FiscalPrinter::Ok);
     }
 
     return bytes;
@@ -403,8 +515,7 @@ void DriverFiscalHasar::statusRequest()
     PackageHasar *p = new PackageHasar;
     p->setCmd(CMD_STATUS);
 
-    queue.append(p);
-    start();
+    queue.push(p, FiscalReply(), ControlLane);
 }
 
 void DriverFiscalHasar::dailyClose(const char type)
@@ -416,8 +527,7 @@ void DriverFiscalHasar::dailyClose(const char type)
     d.append(type);
     p->setData(d);
 
-    queue.append(p);
-    start();
+    queue.push(p);
 }
 
 void DriverFiscalHasar::dailyCloseByDate(const QDate &from, const QDate &to)
@@ -433,8 +543,7 @@ void DriverFiscalHasar::dailyCloseByDate(const QDate &from, const QDate &to)
     d.append('T');
     p->setData(d);
 
-    queue.append(p);
-    start();
+    queue.push(p);
 }
 
 void DriverFiscalHasar::dailyCloseByNumber(const int from, const int to)
@@ -450,8 +559,7 @@ void DriverFiscalHasar::dailyCloseByNumber(const int from, const int to)
     d.append('T');
     p->setData(d);
 
-    queue.append(p);
-    start();
+    queue.push(p);
 }
 
 void DriverFiscalHasar::setCustomerData(const QString &name, const QString &cuit, const char tax_type,
@@ -489,8 +597,7 @@ void DriverFiscalHasar::setCustomerData(const QString &name, const QString &cuit
     }
     p->setData(d);
 
-    queue.append(p);
-    start();
+    queue.push(p);
 }
 
 void DriverFiscalHasar::openFiscalReceipt(const char type)
@@ -504,8 +611,7 @@ void DriverFiscalHasar::openFiscalReceipt(const char type)
     d.append('T');
     p->setData(d);
 
-    queue.append(p);
-    start();
+    queue.push(p);
 }
 
 void DriverFiscalHasar::printFiscalText(const QString &text)
@@ -519,8 +625,7 @@ void DriverFiscalHasar::printFiscalText(const QString &text)
     d.append("0");
     p->setData(d);
 
-    queue.append(p);
-    start();
+    queue.push(p);
 }
 
 void DriverFiscalHasar::printLineItem(const QString &description, const qreal quantity,
@@ -550,8 +655,7 @@ void DriverFiscalHasar::printLineItem(const QString &description, const qreal qu
     d.append('T');
     p->setData(d);
 
-    queue.append(p);
-    start();
+    queue.push(p);
 }
 
 void DriverFiscalHasar::perceptions(const QString &desc, qreal tax_amount)
@@ -567,8 +671,7 @@ void DriverFiscalHasar::perceptions(const QString &desc, qreal tax_amount)
     d.append(QString::number(tax_amount, 'f', 2));
     p->setData(d);
 
-    queue.append(p);
-    start();
+    queue.push(p);
 }
 
 void DriverFiscalHasar::subtotal(const char print)
@@ -582,8 +685,7 @@ void DriverFiscalHasar::subtotal(const char print)
     d.append("Subtotal");
     p->setData(d);
 
-    queue.append(p);
-    start();
+    queue.push(p);
 }
 
 void DriverFiscalHasar::totalTender(const QString &description, const qreal amount, const char type)
@@ -603,8 +705,7 @@ void DriverFiscalHasar::totalTender(const QString &description, const qreal amou
     }
     p->setData(d);
 
-    queue.append(p);
-    start();
+    queue.push(p);
 }
 
 void DriverFiscalHasar::generalDiscount(const QString &description, const qreal amount, const qreal tax_percent, const char type)
@@ -625,8 +726,7 @@ void DriverFiscalHasar::generalDiscount(const QString &description, const qreal
 
     p->setData(d);
 
-    queue.append(p);
-    start();
+    queue.push(p);
 }
 
 void DriverFiscalHasar::closeFiscalReceipt(const char intype, const char f_type, const int id)
@@ -640,8 +740,7 @@ void DriverFiscalHasar::closeFiscalReceipt(const char intype, const char f_type,
     else if(f_type == 'r')
         p->setFtype(3);
     p->setId(id);
-    queue.append(p);
-    start();
+    queue.push(p);
 }
 
 void DriverFiscalHasar::openNonFiscalReceipt()
@@ -653,22 +752,23 @@ void DriverFiscalHasar::openNonFiscalReceipt()
     d.append(" ");
     p->setData(d);
 
-    queue.append(p);
-    start();
+    queue.push(p);
 }
 
 void DriverFiscalHasar::printNonFiscalText(const QString &text)
 {
+    QList<PackageHasar *> batch;
+
     QString t = text;
     while(!t.isEmpty()) {
         PackageHasar *p = new PackageHasar;
         p->setCmd(CMD_PRINTNONTFISCALTEXT);
         p->setData(t.left(40));
         t.remove(0, 40);
-        queue.append(p);
+        batch.append(p);
     }
 
-    start();
+    queue.push(batch);
 }
 
 void DriverFiscalHasar::closeNonFiscalReceipt()
@@ -679,8 +779,7 @@ void DriverFiscalHasar::closeNonFiscalReceipt()
     QByteArray d;
     p->setData(d);
 
-    queue.append(p);
-    start();
+    queue.push(p);
 }
 
 void DriverFiscalHasar::openDrawer()
@@ -688,8 +787,7 @@ void DriverFiscalHasar::openDrawer()
     PackageHasar *p = new PackageHasar;
     p->setCmd(CMD_OPENDRAWER);
 
-    queue.append(p);
-    start();
+    queue.push(p, FiscalReply(), ControlLane);
 }
 
 void DriverFiscalHasar::setHeaderTrailer(const QString &header, const QString &trailer)
@@ -706,8 +804,7 @@ void DriverFiscalHasar::setHeaderTrailer(const QString &header, const QString &t
         d.append(header.left(120));
         p->setData(d);
 
-        queue.append(p);
-        start();
+        queue.push(p);
     }*/
 
 
@@ -725,8 +822,7 @@ void DriverFiscalHasar::setHeaderTrailer(const QString &header, const QString &t
 
     p->setData(d);
 
-    queue.append(p);
-    start();
+    queue.push(p);
 }
 
 void DriverFiscalHasar::setEmbarkNumber(const int doc_num, const QString &description, const char type)
@@ -740,8 +836,7 @@ void DriverFiscalHasar::setEmbarkNumber(const int doc_num, const QString &descri
     d.append(description);
     p->setData(d);
 
-    queue.append(p);
-    start();
+    queue.push(p);
 }
 
 void DriverFiscalHasar::openDNFH(const char type, const char fix_value, const QString &doc_num)
@@ -760,8 +855,7 @@ void DriverFiscalHasar::openDNFH(const char type, const char fix_value, const QS
     }
     p->setData(d);
 
-    queue.append(p);
-    start();
+    queue.push(p);
 }
 
 void DriverFiscalHasar::printEmbarkItem(const QString &description, const qreal quantity)
@@ -777,8 +871,7 @@ void DriverFiscalHasar::printEmbarkItem(const QString &description, const qreal
     d.append("0");
     p->setData(d);
 
-    queue.append(p);
-    start();
+    queue.push(p);
 }
 
 void DriverFiscalHasar::closeDNFH(const int id, const char f_type, const int copies)
@@ -794,17 +887,42 @@ void DriverFiscalHasar::closeDNFH(const int id, const char f_type, const int cop
     p->setFtype(f_type == 'R' ? 1 : 2);
     p->setId(id);
 
-    queue.append(p);
-    start();
+    queue.push(p);
+}
+
+static DocumentMark documentMark(PackageHasar * const &p)
+{
+    switch(p->cmd()) {
+    case DriverFiscalHasar::CMD_OPENFISCALRECEIPT:
+    case DriverFiscalHasar::CMD_OPENDNFH:
+    case DriverFiscal::CMD_OPENNONFISCALRECEIPT:
+        return OpensDocument;
+    case DriverFiscalHasar::CMD_CLOSEFISCALRECEIPT:
+    case DriverFiscalHasar::CMD_CLOSEDNFH:
+    case DriverFiscal::CMD_CLOSENONFISCALRECEIPT:
+    case DriverFiscalHasar::CMD_CANCEL: // voidDocument() queues it where the close would go
+        return ClosesDocument;
+    }
+    return NoMark;
 }
 
 void DriverFiscalHasar::cancel()
 {
+    // the frames of the document it voids would open or go on after it
+    qDeleteAll(queue.takeDocument(documentOpen(), documentMark));
+
     PackageHasar *p = new PackageHasar;
     p->setCmd(CMD_CANCEL);
 
-    queue.append(p);
-    start();
+    queue.push(p, FiscalReply(), UrgentLane);
+}
+
+void DriverFiscalHasar::voidDocument()
+{
+    PackageHasar *p = new PackageHasar;
+    p->setCmd(CMD_CANCEL);
+
+    queue.push(p);
 }
 
 void DriverFiscalHasar::ack()
@@ -822,8 +940,7 @@ void DriverFiscalHasar::setDateTime(const QDateTime &dateTime)
     d.append(dateTime.time().toString("HHmmss"));
     p->setData(d);
 
-    queue.append(p);
-    start();
+    queue.push(p);
 }
 
 void DriverFiscalHasar::receiptText(const QString &text)
@@ -834,8 +951,7 @@ void DriverFiscalHasar::receiptText(const QString &text)
     d.append(text.left(100));
     p->setData(d);
 
-    queue.append(p);
-    start();
+    queue.push(p);
 }
 
 void DriverFiscalHasar::reprintDocument(const QString &doc_type, const int doc_number)
@@ -852,6 +968,8 @@ void DriverFiscalHasar::reprintFinalize()
 
 void DriverFiscalHasar::setFixedData(const QString &shop, const QString &phone)
 {
+    QList<PackageHasar *> batch;
+
     QByteArray d;
 
     PackageHasar *pp = new PackageHasar;
@@ -861,7 +979,7 @@ void DriverFiscalHasar::setFixedData(const QString &shop, const QString &phone)
     d.append(PackageFiscal::FS);
     d.append("DEFENSA CONSUMIDOR " + phone);
     pp->setData(d);
-    queue.append(pp);
+    batch.append(pp);
     d.clear();
 
     PackageHasar *p1 = new PackageHasar;
@@ -871,7 +989,7 @@ void DriverFiscalHasar::setFixedData(const QString &shop, const QString &phone)
     d.append(PackageFiscal::FS);
     d.append("Ingresa en www.global.subway.com Danos");
     p1->setData(d);
-    queue.append(p1);
+    batch.append(p1);
     d.clear();
 
     PackageHasar *p2 = new PackageHasar;
@@ -881,7 +999,7 @@ void DriverFiscalHasar::setFixedData(const QString &shop, const QString &phone)
     d.append(PackageFiscal::FS);
     d.append("tu opinion y obtene una COOKIE GRATIS");
     p2->setData(d);
-    queue.append(p2);
+    batch.append(p2);
     d.clear();
 
     PackageHasar *p3 = new PackageHasar;
@@ -891,7 +1009,7 @@ void DriverFiscalHasar::setFixedData(const QString &shop, const QString &phone)
     d.append(PackageFiscal::FS);
     d.append(QString("en tu proxima compra. Tienda: %1-0").arg(shop));
     p3->setData(d);
-    queue.append(p3);
+    batch.append(p3);
     d.clear();
 
     /*
@@ -902,7 +1020,7 @@ void DriverFiscalHasar::setFixedData(const QString &shop, const QString &phone)
     d.append(PackageFiscal::FS);
     d.append("compra. Valido dentro de los 5 dias de");
     p4->setData(d);
-    queue.append(p4);
+    batch.append(p4);
     d.clear();
 
     PackageHasar *p5 = new PackageHasar;
@@ -912,7 +1030,7 @@ void DriverFiscalHasar::setFixedData(const QString &shop, const QString &phone)
     d.append(PackageFiscal::FS);
     d.append(QString("emision del ticket. Tienda: %1-0").arg(shop));
     p5->setData(d);
-    queue.append(p5);
+    batch.append(p5);
     d.clear();
 
     PackageHasar *p6 = new PackageHasar;
@@ -922,7 +1040,7 @@ void DriverFiscalHasar::setFixedData(const QString &shop, const QString &phone)
     d.append(PackageFiscal::FS);
     d.append(0x7f);
     p6->setData(d);
-    queue.append(p6);
+    batch.append(p6);
     d.clear();
 
     PackageHasar *p7 = new PackageHasar;
@@ -932,7 +1050,7 @@ void DriverFiscalHasar::setFixedData(const QString &shop, const QString &phone)
     d.append(PackageFiscal::FS);
     d.append(0x7f);
     p7->setData(d);
-    queue.append(p7);
+    batch.append(p7);
     d.clear();
 
     PackageHasar *p8 = new PackageHasar;
@@ -942,7 +1060,7 @@ void DriverFiscalHasar::setFixedData(const QString &shop, const QString &phone)
     d.append(PackageFiscal::FS);
     d.append(0x7f);
     p8->setData(d);
-    queue.append(p8);
+    batch.append(p8);
     d.clear();
 
     PackageHasar *p9 = new PackageHasar;
@@ -952,7 +1070,7 @@ void DriverFiscalHasar::setFixedData(const QString &shop, const QString &phone)
     d.append(PackageFiscal::FS);
     d.append(0x7f);
     p9->setData(d);
-    queue.append(p9);
+    batch.append(p9);
     d.clear();
 
     PackageHasar *p10 = new PackageHasar;
@@ -962,7 +1080,7 @@ void DriverFiscalHasar::setFixedData(const QString &shop, const QString &phone)
     d.append(PackageFiscal::FS);
     d.append(0x7f);
     p10->setData(d);
-    queue.append(p10);
+    batch.append(p10);
     d.clear();
 
     PackageHasar *p11 = new PackageHasar;
@@ -972,11 +1090,11 @@ void DriverFiscalHasar::setFixedData(const QString &shop, const QString &phone)
     d.append(PackageFiscal::FS);
     d.append(0x7f);
     p11->setData(d);
-    queue.append(p11);
+    batch.append(p11);
     d.clear();
     */
 
-    start();
+    queue.push(batch);
 }
 
 void DriverFiscalHasar::getTransactionalMemoryInfo()
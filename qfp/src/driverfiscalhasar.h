@@ -107,10 +107,15 @@ public:
     virtual void reprintContinue();
     virtual void reprintFinalize();
     virtual void cancel();
+    virtual void voidDocument();
     virtual void ack();
     virtual void setDateTime(const QDateTime &dateTime);
     virtual void setFixedData(const QString &shop, const QString &phone);
     virtual void finish();
+    virtual int queueDepth();
+    virtual bool setJournal(CommandJournal *journal);
+    virtual void beginBatch(const FiscalReply &reply = FiscalReply());
+    virtual void endBatch();
 
     virtual void getTransactionalMemoryInfo();
     virtual void downloadReportByDate(const QString &type, const QDate &form, const QDate &to);
@@ -123,18 +128,28 @@ signals:
     void fiscalReceiptNumber(int id, int number, int type); // type == 0 Factura, == 1 NC
     void fiscalStatus(int state);
     void fiscalData(int cmd, QVariant data);
+    void statusChanged(int status, int changed);
 
 protected:
     void run();
+    virtual int decodeStatus(const int printer, const int fiscal);
 
 private:
+    int nextSecuence();
     void sendAck();
     void errorHandler();
+    void recover();
+    bool transact(PackageHasar *p);
+    void journalQueued(PackageHasar *p);
+    void journalAcked(const int cmd, const bool ok);
     bool m_error;
-    QVector<PackageHasar *> queue;
+    CommandQueue<PackageHasar *> queue;
     FiscalPrinter::Model m_model;
     int errorHandler_count;
     int m_nak_count;
+    int m_secuence;
+    CommandJournal *m_journal;
+    bool m_recover; // the journal holds a document from a previous run
 };
 
 #endif // DRIVERFISCALHASAR_H
@@ -35,21 +35,48 @@
 #include "driverfiscalhasar2g.h"
 #include "packagefiscal.h"
 #include "networkport.h"
+#include "jsontemplate.h"
 #include "logger.h"
 
 #include <QDateTime>
-#include <QEventLoop>
+#include <QThread>
+#include <QTimer>
 
 #define CLOSEDOCCMD "CerrarDocumento"
 
+// Bodies of the commands sent once per line, laid out the way QJson::Serializer
+// writes them: keys sorted, "{ ", " : ", ", " and " }" between the tokens
+static const JsonTemplate FISCALTEXT("{ \"ImprimirTextoFiscal\" : { \"Texto\" : $ } }");
+static const JsonTemplate LINEITEM("{ \"ImprimirItem\" : { \"AlicuotaIVA\" : $, \"Cantidad\" : $, "
+        "\"CodigoInterno\" : \"\", \"CodigoProducto\" : $, \"CondicionIVA\" : \"Gravado\", "
+        "\"Descripcion\" : $, \"MagnitudImpuestoInterno\" : \"0.00\", \"ModoBaseTotal\" : \"ModoPrecioTotal\", "
+        "\"ModoDisplay\" : \"DisplayNo\", \"OperacionMonto\" : \"ModoSumaMonto\", \"PrecioUnitario\" : $, "
+        "\"TipoImpuestoInterno\" : \"IIVariableKIVA\", \"UnidadMedida\" : \"Unidad\", \"UnidadReferencia\" : \"1\" } }");
+static const JsonTemplate PERCEPTION("{ \"ImprimirOtrosTributos\" : { \"BaseImponible\" : \"**.**\", "
+        "\"Codigo\" : $, \"Descripcion\" : $, \"Importe\" : $ } }");
+static const JsonTemplate PAYMENT("{ \"ImprimirPago\" : { \"Descripcion\" : $, \"Monto\" : $, \"Operacion\" : \"Pagar\" } }");
+static const JsonTemplate DISCOUNT("{ \"ImprimirAjuste\" : { \"Descripcion\" : $, "
+        "\"ModoBaseTotal\" : \"ModoPrecioTotal\", \"Monto\" : $, \"Operacion\" : $ } }");
+static const JsonTemplate NONFISCALTEXT("{ \"ImprimirTextoGenerico\" : { \"Texto\" : $ } }");
+
+// A command whose body is already JSON: the only key is the command, for
+// verifyPackage(), the value the bytes to post
+static QVariantMap compiled(const char *cmd, const JsonTemplate &t, const QString *values)
+{
+    QVariantMap d;
+    d.insert(QLatin1String(cmd), t.render(values));
+    return d;
+}
+
 DriverFiscalHasar2G::DriverFiscalHasar2G(QObject *parent, Connector *m_connector, int m_TIME_WAIT)
-    : QThread(parent), DriverFiscal(parent, m_connector, m_TIME_WAIT)
+    : QObject(parent), DriverFiscal(parent, m_connector, m_TIME_WAIT)
 {
     m_error = false;
     cancel_count = 0;
+    m_pending = false;
+    m_busy = false;
     m_continue = true;
-    connect(this, SIGNAL(sendData(const QVariantMap &)),
-            m_connector, SLOT(post(const QVariantMap &)));
+    connect(m_connector, SIGNAL(finished()), this, SLOT(replyFinished()));
 }
 
 void DriverFiscalHasar2G::setModel(const FiscalPrinter::Model model)
@@ -57,60 +84,111 @@ void DriverFiscalHasar2G::setModel(const FiscalPrinter::Model model)
     m_model = model;
 }
 
-void DriverFiscalHasar2G::run()
+void DriverFiscalHasar2G::dispatch()
 {
-    while(!queue.empty() && m_continue) {
-        QVariantMap pkg = queue.first();
-        QVariantMap result;
-        sendData(pkg);
+    if (m_busy || !m_continue)
+        return;
 
+    if (!m_pending) {
+        if (!queue.pop(&m_pkg, &m_result, documentOpen(), 0))
+            return;
+        m_pending = true;
+    }
 
-        QEventLoop loop;
-        connect(m_connector, SIGNAL(finished()), &loop, SLOT(quit()));
-        loop.exec();
+    m_busy = true;
+    // bodies from a JsonTemplate go out as they are
+    if (m_pkg.size() == 1 && m_pkg.constBegin().value().type() == QVariant::ByteArray)
+        m_connector->postJson(m_pkg.constBegin().value().toByteArray());
+    else
+        m_connector->post(m_pkg);
+}
+
+void DriverFiscalHasar2G::replyFinished()
+{
+    m_busy = false;
+    if (!m_continue)
+        return;
 
-        if (m_connector->lastError() != NetworkPort::NP_NO_ERROR) {
-            emit fiscalStatus(FiscalPrinter::Error);
+    if (m_connector->lastError() != NetworkPort::NP_NO_ERROR) {
+        reportOk(false, false);
+        emit fiscalStatus(FiscalPrinter::Error);
 #ifdef DEBUG
-            log << QString("DriverFiscalHasar2G::run() -> Error: %1").arg(m_connector->lastError());
+        log << QString("DriverFiscalHasar2G::replyFinished() -> Error: %1").arg(m_connector->lastError());
 #endif
-            continue;
-        }
+        // retried, but without spinning the thread the other printers share
+        QTimer::singleShot(m_TIME_WAIT, this, SLOT(dispatch()));
+        return;
+    }
 
-        const QVariantMap reply = m_connector->lastReply();
+    const QVariantMap reply = m_connector->lastReply();
 
-        if (!verifyPackage(pkg, reply)) {
-            queue.clear();
-            cancel_count++;
-            if (cancel_count < 3)
-                cancel();
-            continue;
-        }
+    m_result.setValue(reply);
 
-        emit fiscalStatus(FiscalPrinter::Ok);
+    // the state comes with every answer, rejected ones included
+    if (reply.size())
+        updateStatus(decodeStatus(reply[reply.keys()[0]].toMap()["Estado"].toMap()));
+
+    if (!verifyPackage(m_pkg, reply)) {
+        reportOk(false, false);
+        m_result.complete(false);
+        m_pending = false;
+        queue.clear();
+        cancel_count++;
+        if (cancel_count < 3)
+            cancel();
+        dispatch();
+        return;
+    }
 
-        if (reply.keys()[0].compare(CLOSEDOCCMD) == 0) {
-            emit fiscalReceiptNumber(pkg[CLOSEDOCCMD].toMap()["id"].toInt(),
-                    getReceiptNumber(reply[CLOSEDOCCMD].toMap()["NumeroComprobante"].toByteArray()),
-                    pkg[CLOSEDOCCMD].toMap()["ftype"].toInt());
-        }
+    if (reportOk(true, m_pkg.contains("ConsultarEstado")))
+        emit fiscalStatus(FiscalPrinter::Ok);
 
-        cancel_count = 0;
-        queue.pop_front();
+    if (reply.keys()[0].compare(CLOSEDOCCMD) == 0) {
+        emit fiscalReceiptNumber(m_pkg[CLOSEDOCCMD].toMap()["id"].toInt(),
+                getReceiptNumber(reply[CLOSEDOCCMD].toMap()["NumeroComprobante"].toByteArray()),
+                m_pkg[CLOSEDOCCMD].toMap()["ftype"].toInt());
     }
 
+    m_result.complete(true);
+    cancel_count = 0;
+    m_pending = false;
+    dispatch();
 }
 
-void DriverFiscalHasar2G::finish()
+void DriverFiscalHasar2G::shutdown()
 {
-    m_continue = false;
+    interrupt();
     queue.clear();
-    quit();
+    queue.close();
+    if (m_pending)
+        m_result.cancel();
+    m_pending = false;
+}
 
-    while(isRunning()) {
-        msleep(100);
-        quit();
-    }
+void DriverFiscalHasar2G::finish()
+{
+    // m_result and the queue head belong to the thread the driver lives in
+    if (thread() == QThread::currentThread() || !thread()->isRunning())
+        shutdown();
+    else
+        QMetaObject::invokeMethod(this, "shutdown", Qt::BlockingQueuedConnection);
+}
+
+int DriverFiscalHasar2G::queueDepth()
+{
+    return queue.size();
+}
+
+void DriverFiscalHasar2G::beginBatch(const FiscalReply &reply)
+{
+    queue.beginBatch(reply);
+}
+
+void DriverFiscalHasar2G::endBatch()
+{
+    queue.endBatch();
+    // every FiscalPrinter command ends here, wake up the driver's thread
+    QMetaObject::invokeMethod(this, "dispatch", Qt::QueuedConnection);
 }
 
 
@@ -127,6 +205,47 @@ int DriverFiscalHasar2G::getReceiptNumber(const QByteArray &data)
     return data.trimmed().toInt();
 }
 
+int DriverFiscalHasar2G::decodeStatus(const QVariantMap &status)
+{
+    static const struct {
+        const char *name;
+        int flag;
+    } printerBits[] = {
+        { "ErrorImpresora", FiscalPrinter::PrinterError },
+        { "ImpresoraOffLine", FiscalPrinter::PrinterOffline },
+        { "PocoPapelAuditoria", FiscalPrinter::PaperLow },
+        { "PocoPapelComprobantes", FiscalPrinter::PaperLow },
+        { "FaltaPapelJournal", FiscalPrinter::PaperOut },
+        { "FaltaPapelReceipt", FiscalPrinter::PaperOut },
+        { "TapaAbierta", FiscalPrinter::CoverOpen },
+        { "CajonAbierto", FiscalPrinter::DrawerOpen },
+        { 0, 0 }
+    }, fiscalBits[] = {
+        { "ErrorMemoriaFiscal", FiscalPrinter::FiscalMemoryError },
+        { "ErrorMemoriaTrabajo", FiscalPrinter::FiscalMemoryError },
+        { "MemoriaFiscalCasiLlena", FiscalPrinter::FiscalMemoryNearFull },
+        { "MemoriaFiscalLlena", FiscalPrinter::FiscalMemoryFull },
+        { "DocumentoFiscalAbierto", FiscalPrinter::FiscalDocumentOpen },
+        { "DocumentoAbierto", FiscalPrinter::DocumentOpen },
+        { 0, 0 }
+    };
+
+    const QVariantList printer = status["Impresora"].toList();
+    const QVariantList fiscal = status["Fiscal"].toList();
+    int flags = 0;
+
+    for (int i = 0; printerBits[i].name; i++) {
+        if (printer.contains(printerBits[i].name))
+            flags |= printerBits[i].flag;
+    }
+    for (int i = 0; fiscalBits[i].name; i++) {
+        if (fiscal.contains(fiscalBits[i].name))
+            flags |= fiscalBits[i].flag;
+    }
+
+    return flags;
+}
+
 bool DriverFiscalHasar2G::getStatus(const QVariantMap &status)
 {
     if (!status.size())
@@ -176,8 +295,7 @@ void DriverFiscalHasar2G::statusRequest()
     state["MensajeCF"];
     d["ConsultarEstado"] = state;
 
-    queue.append(d);
-    start();
+    queue.push(d, FiscalReply(), ControlLane);
 }
 
 void DriverFiscalHasar2G::dailyClose(const char type)
@@ -188,8 +306,7 @@ void DriverFiscalHasar2G::dailyClose(const char type)
     report["Reporte"] = type == 'Z' ? "ReporteZ" : "ReporteX";
     d["CerrarJornadaFiscal"] = report;
 
-    queue.append(d);
-    start();
+    queue.push(d);
 }
 
 void DriverFiscalHasar2G::dailyCloseByDate(const QDate &from, const QDate &to)
@@ -202,8 +319,7 @@ void DriverFiscalHasar2G::dailyCloseByDate(const QDate &from, const QDate &to)
     report["Reporte"] = "ReportarAuditoriaGlobal";
     d["ReportarZetasPorFecha"] = report;
 
-    queue.append(d);
-    start();
+    queue.push(d);
 }
 
 void DriverFiscalHasar2G::dailyCloseByNumber(const int from, const int to)
@@ -216,8 +332,7 @@ void DriverFiscalHasar2G::dailyCloseByNumber(const int from, const int to)
     report["Reporte"] = "ReportarAuditoriaGlobal";
     d["ReportarZetasPorNumeroZeta"] = report;
 
-    queue.append(d);
-    start();
+    queue.push(d);
 }
 
 void DriverFiscalHasar2G::setCustomerData(const QString &name, const QString &cuit, const char tax_type,
@@ -262,8 +377,7 @@ void DriverFiscalHasar2G::setCustomerData(const QString &name, const QString &cu
     customer["Domicilio"] = address;
     d["CargarDatosCliente"] = customer;
 
-    queue.append(d);
-    start();
+    queue.push(d);
 }
 
 void DriverFiscalHasar2G::openFiscalReceipt(const char type)
@@ -306,20 +420,12 @@ void DriverFiscalHasar2G::openFiscalReceipt(const char type)
 
     d["AbrirDocumento"] = openReceipt;
 
-    queue.append(d);
-    start();
+    queue.push(d);
 }
 
 void DriverFiscalHasar2G::printFiscalText(const QString &text)
 {
-    QVariantMap d;
-    QVariantMap t;
-
-    t["Texto"] = text;
-    d["ImprimirTextoFiscal"] = t;
-
-    queue.append(d);
-    start();
+    queue.push(compiled("ImprimirTextoFiscal", FISCALTEXT, &text));
 }
 
 void DriverFiscalHasar2G::printLineItem(const QString &description, const qreal quantity,
@@ -328,43 +434,24 @@ void DriverFiscalHasar2G::printLineItem(const QString &description, const qreal
     Q_UNUSED(quantity);
     Q_UNUSED(excise);
 
-    QVariantMap d;
-    QVariantMap item;
-
-    item["Descripcion"] =  description;
-    item["Cantidad"] = QString::number(quantity, 'f', 2);
-    item["PrecioUnitario"] = QString::number(price, 'f', 2);
-    item["CondicionIVA"] = "Gravado";
-    item["AlicuotaIVA"] = tax;
-    item["OperacionMonto"] = "ModoSumaMonto";
-    item["TipoImpuestoInterno"] = "IIVariableKIVA";
-    item["MagnitudImpuestoInterno"] = "0.00";
-    item["ModoDisplay"] = "DisplayNo";
-    item["ModoBaseTotal"] = "ModoPrecioTotal";
-    item["UnidadReferencia"] = "1";
-    item["CodigoProducto"] = QString(description).remove(" ");
-    item["CodigoInterno"] = "";
-    item["UnidadMedida"] = "Unidad";
-    d["ImprimirItem"] = item;
-
-    queue.append(d);
-    start();
+    const QString v[] = {
+        tax,
+        QString::number(quantity, 'f', 2),
+        QString(description).remove(" "),
+        description,
+        QString::number(price, 'f', 2)
+    };
+    queue.push(compiled("ImprimirItem", LINEITEM, v));
 }
 
 void DriverFiscalHasar2G::perceptions(const QString &desc, qreal tax_amount)
 {
-    QVariantMap d;
-    QVariantMap perc;
-
-    QString code = desc;
-    perc["Codigo"] = code.remove(" ");
-    perc["Descripcion"] = desc;
-    perc["BaseImponible"] = "**.**";
-    perc["Importe"] = QString::number(tax_amount, 'f', 2);
-    d["ImprimirOtrosTributos"] = perc;
-
-    queue.append(d);
-    start();
+    const QString v[] = {
+        QString(desc).remove(" "),
+        desc,
+        QString::number(tax_amount, 'f', 2)
+    };
+    queue.push(compiled("ImprimirOtrosTributos", PERCEPTION, v));
 }
 
 void DriverFiscalHasar2G::subtotal(const char print)
@@ -375,41 +462,27 @@ void DriverFiscalHasar2G::subtotal(const char print)
     subt["Impresion"] = print == 'P' ? "ImprimeSubtotal" : "NoImprimeSubtotal";
     d["ConsultarSubtotal"] = subt;
 
-    queue.append(d);
-    start();
+    queue.push(d);
 }
 
 void DriverFiscalHasar2G::totalTender(const QString &description, const qreal amount, const char type)
 {
     Q_UNUSED(type);
 
-    QVariantMap d;
-    QVariantMap payment;
-
-    payment["Descripcion"] = description;
-    payment["Monto"] = QString::number(amount, 'f', 2);
-    payment["Operacion"] = "Pagar";
-    d["ImprimirPago"] = payment;
-
-    queue.append(d);
-    start();
+    const QString v[] = { description, QString::number(amount, 'f', 2) };
+    queue.push(compiled("ImprimirPago", PAYMENT, v));
 }
 
 void DriverFiscalHasar2G::generalDiscount(const QString &description, const qreal amount, const qreal tax_percent, const char type)
 {
     Q_UNUSED(tax_percent);
 
-    QVariantMap d;
-    QVariantMap discount;
-
-    discount["Descripcion"] = description;
-    discount["Monto"] = QString::number(amount, 'f', 2);
-    discount["ModoBaseTotal"] = "ModoPrecioTotal";
-    discount["Operacion"] = type == 'M' ? "AjustePos" : "AjusteNeg";
-    d["ImprimirAjuste"] = discount;
-
-    queue.append(d);
-    start();
+    const QString v[] = {
+        description,
+        QString::number(amount, 'f', 2),
+        QLatin1String(type == 'M' ? "AjustePos" : "AjusteNeg")
+    };
+    queue.push(compiled("ImprimirAjuste", DISCOUNT, v));
 }
 
 void DriverFiscalHasar2G::closeFiscalReceipt(const char intype, const char f_type, const int id)
@@ -439,8 +512,7 @@ void DriverFiscalHasar2G::closeFiscalReceipt(const char intype, const char f_typ
     doc["Copias"] = "0";
     d["CerrarDocumento"] = doc;
 
-    queue.append(d);
-    start();
+    queue.push(d);
 }
 
 void DriverFiscalHasar2G::openNonFiscalReceipt()
@@ -451,24 +523,19 @@ void DriverFiscalHasar2G::openNonFiscalReceipt()
     doc["CodigoComprobante"] = "Generico";
     d["AbrirDocumento"] = doc;
 
-    queue.append(d);
-    start();
+    queue.push(d);
 }
 
 void DriverFiscalHasar2G::printNonFiscalText(const QString &text)
 {
-    QVariantMap d;
-    QVariantMap mt;
-
-    QString t = text;
-    while(!t.isEmpty()) {
-        mt["Texto"] = t.left(39);
-        d["ImprimirTextoGenerico"] = mt;
-        t.remove(0, 39);
-        queue.append(d);
+    QList<QVariantMap> batch;
+
+    for (int i = 0; i < text.size(); i += 39) {
+        const QString line = text.mid(i, 39);
+        batch.append(compiled("ImprimirTextoGenerico", NONFISCALTEXT, &line));
     }
 
-    start();
+    queue.push(batch);
 }
 
 void DriverFiscalHasar2G::closeNonFiscalReceipt()
@@ -479,8 +546,7 @@ void DriverFiscalHasar2G::closeNonFiscalReceipt()
     doc["Copias"] = "0";
     d["CerrarDocumento"] = doc;
 
-    queue.append(d);
-    start();
+    queue.push(d);
 }
 
 void DriverFiscalHasar2G::openDrawer()
@@ -489,12 +555,13 @@ void DriverFiscalHasar2G::openDrawer()
 
     d["AbrirCajonDinero"] = QVariantMap();
 
-    queue.append(d);
-    start();
+    queue.push(d, FiscalReply(), ControlLane);
 }
 
 void DriverFiscalHasar2G::setHeaderTrailer(const QString &header, const QString &trailer)
 {
+    QList<QVariantMap> batch;
+
     QVariantMap d;
     QVariantMap zona;
 
@@ -508,8 +575,7 @@ void DriverFiscalHasar2G::setHeaderTrailer(const QString &header, const QString
     zona["Estacion"] = "EstacionPorDefecto";
     zona["IdentificadorZona"] = "Zona1Encabezado";
     d["ConfigurarZona"] = zona;
-    queue.append(d);
-    start();
+    batch.append(d);
 
     if (!trailer.isEmpty()) {
         zona["NumeroLinea"] = "1";
@@ -522,9 +588,9 @@ void DriverFiscalHasar2G::setHeaderTrailer(const QString &header, const QString
     zona["IdentificadorZona"] = "Zona1Cola";
     d["ConfigurarZona"] = zona;
 
-    queue.append(d);
-    start();
+    batch.append(d);
 
+    queue.push(batch);
 }
 
 void DriverFiscalHasar2G::setEmbarkNumber(const int doc_num, const QString &description, const char type)
@@ -565,8 +631,7 @@ void DriverFiscalHasar2G::setEmbarkNumber(const int doc_num, const QString &desc
     doc["NumeroComprobante"] = description.right(8);
     d["CargarDocumentoAsociado"] = doc;
 
-    queue.append(d);
-    start();
+    queue.push(d);
 }
 
 void DriverFiscalHasar2G::openDNFH(const char type, const char fix_value, const QString &doc_num)
@@ -583,14 +648,35 @@ void DriverFiscalHasar2G::closeDNFH(const int id, const char f_type, const int c
     closeFiscalReceipt(0, f_type, id);
 }
 
+static DocumentMark documentMark(const QVariantMap &pkg)
+{
+    if (pkg.contains("AbrirDocumento"))
+        return OpensDocument;
+    // voidDocument() queues its Cancelar where the close would go
+    if (pkg.contains(CLOSEDOCCMD) || pkg.contains("Cancelar"))
+        return ClosesDocument;
+    return NoMark;
+}
+
 void DriverFiscalHasar2G::cancel()
 {
+    // the commands of the document it voids would open or go on after it
+    queue.takeDocument(documentOpen(), documentMark);
+
     QVariantMap d;
 
     d["Cancelar"] = QVariantMap();
 
-    queue.append(d);
-    start();
+    queue.push(d, FiscalReply(), UrgentLane);
+}
+
+void DriverFiscalHasar2G::voidDocument()
+{
+    QVariantMap d;
+
+    d["Cancelar"] = QVariantMap();
+
+    queue.push(d);
 }
 
 void DriverFiscalHasar2G::setDateTime(const QDateTime &dateTime)
@@ -602,8 +688,7 @@ void DriverFiscalHasar2G::setDateTime(const QDateTime &dateTime)
     report["Hora"] = dateTime.time().toString("HHmmss");
     d["ConfigurarFechaHora"] = report;
 
-    queue.append(d);
-    start();
+    queue.push(d);
 }
 
 // --------------------------------- //
@@ -628,8 +713,7 @@ void DriverFiscalHasar2G::reprintDocument(const QString &doc_type, const int doc
     doc["NumeroComprobante"] = QString::number(doc_number);
     d["CopiarComprobante"] = doc;
 
-    queue.append(d);
-    start();
+    queue.push(d);
 }
 
 void DriverFiscalHasar2G::reprintContinue()
@@ -705,8 +789,7 @@ void DriverFiscalHasar2G::downloadReportByDate(const QString &type, const QDate
     report["TipoReporte"] = "ReporteAFIPCompleto";
     d["ObtenerPrimerBloqueReporteElectronico"] = report;
 
-    queue.append(d);
-    start();
+    queue.push(d);
 }
 
 void DriverFiscalHasar2G::downloadReportByNumber(const QString &type, const int from, const int to)
@@ -720,8 +803,7 @@ void DriverFiscalHasar2G::downloadContinue()
 
     d["ObtenerSiguienteBloqueReporteElectronico"] = "";
 
-    queue.append(d);
-    start();
+    queue.push(d);
 }
 
 void DriverFiscalHasar2G::downloadFinalize()
@@ -35,13 +35,15 @@
 #ifndef DRIVERFISCALHASAR2G_H
 #define DRIVERFISCALHASAR2G_H
 
-#include <QThread>
+#include <QObject>
 
 #include "driverfiscal.h"
 #include "packagehasar.h"
 #include "fiscalprinter.h"
 
-class DriverFiscalHasar2G : public QThread, virtual public DriverFiscal
+// Event driven, no thread of its own: lives in the thread of its
+// Connector, which a FiscalPrinterPool shares among all its printers.
+class DriverFiscalHasar2G : public QObject, virtual public DriverFiscal
 {
     Q_OBJECT
 
@@ -85,10 +87,14 @@ public:
     virtual void reprintContinue();
     virtual void reprintFinalize();
     virtual void cancel();
+    virtual void voidDocument();
     virtual void ack();
     virtual void setDateTime(const QDateTime &dateTime);
     virtual void setFixedData(const QString &shop, const QString &phone);
     virtual void finish();
+    virtual int queueDepth();
+    virtual void beginBatch(const FiscalReply &reply = FiscalReply());
+    virtual void endBatch();
 
     virtual void getTransactionalMemoryInfo();
     virtual void downloadReportByDate(const QString &type, const QDate &form, const QDate &to);
@@ -97,24 +103,31 @@ public:
     virtual void downloadFinalize();
     virtual void downloadDelete(const int to);
 
-protected:
-    void run();
-
 signals:
     void fiscalReceiptNumber(int id, int number, int type); // type == 0 Factura, == 1 NC
     void fiscalStatus(int state);
     void fiscalData(int cmd, QVariant data);
-    void sendData(const QVariantMap &);
+    void statusChanged(int status, int changed);
+
+private slots:
+    void dispatch(); // posts the next command unless one is on the way
+    void replyFinished();
+    void shutdown();
 
 private:
     bool verifyPackage(const QVariantMap &pkg, const QVariantMap &reply);
     bool getStatus(const QVariantMap &status);
+    int decodeStatus(const QVariantMap &status);
 
     void errorHandler();
     bool m_error;
-    QVector<QVariantMap> queue;
+    CommandQueue<QVariantMap> queue;
     FiscalPrinter::Model m_model;
     int cancel_count;
+    QVariantMap m_pkg;
+    FiscalReply m_result;
+    bool m_pending; // m_pkg taken from the queue and not answered yet
+    bool m_busy; // m_pkg posted, waiting for replyFinished()
 };
 
 #endif // DRIVERFISCALHASAR2G_H
@@ -37,16 +37,30 @@
 #include "driverfiscalepsonext.h"
 #include "driverfiscalhasar.h"
 #include "driverfiscalhasar2g.h"
+#include "commandjournal.h"
+#include "receiptledger.h"
+#include "journalindex.h"
 #include "logger.h"
 
 #include <QCoreApplication>
+#include <QThread>
 #include <QRegExp>
 #include <QDebug>
 
+// ms settle() waits for the printer to tell its status
+static const int SETTLE_WAIT = 2000;
+// failed closes that may have printed kept to refuse their retries
+static const int MAX_DOUBTFUL = 64;
+
 FiscalPrinter::FiscalPrinter(QObject *parent, FiscalPrinter::Brand brand,
         FiscalPrinter::Model model, const QString &port_type, const QString &port,
-        const QString &settings, int m_TIME_WAIT)
+        const QString &settings, int m_TIME_WAIT, QThread *ioThread)
     : QObject(parent)
+    , m_ioThread(0)
+    , m_ownIoThread(false)
+    , m_journal(0)
+    , m_ledger(0)
+    , m_index(0)
     , m_model(model)
 
 {
@@ -57,7 +71,8 @@ FiscalPrinter::FiscalPrinter(QObject *parent, FiscalPrinter::Brand brand,
     log << QString("Start Logging at %1").arg(QDateTime::currentDateTime().toString("dd/MM/yyyy HH:mm:ss"));
 #endif
 
-    m_connector = new Connector(this, model, port_type, port, settings);
+    // the network driver has no thread of its own, it runs in m_ioThread
+    m_connector = new Connector(model == Hasar1000F ? 0 : this, model, port_type, port, settings);
 
     if (brand == FiscalPrinter::Epson) {
         if (model == EpsonTM900) {
@@ -69,6 +84,10 @@ FiscalPrinter::FiscalPrinter(QObject *parent, FiscalPrinter::Brand brand,
                     this, SIGNAL(fiscalData(int, QVariant)));
             connect(dynamic_cast<DriverFiscalEpsonExt *>(m_driverFiscal), SIGNAL(fiscalStatus(int)),
                     this, SIGNAL(fiscalStatus(int)));
+            connect(dynamic_cast<DriverFiscalEpsonExt *>(m_driverFiscal), SIGNAL(statusChanged(int, int)),
+                    this, SIGNAL(statusChanged(int, int)));
+            connect(dynamic_cast<DriverFiscalEpsonExt *>(m_driverFiscal), SIGNAL(downloadProgress(qint64)),
+                    this, SIGNAL(downloadProgress(qint64)));
         } else {
             m_driverFiscal = new DriverFiscalEpson(this, m_connector);
             dynamic_cast<DriverFiscalEpson *>(m_driverFiscal)->setModel(model);
@@ -76,15 +95,28 @@ FiscalPrinter::FiscalPrinter(QObject *parent, FiscalPrinter::Brand brand,
                     this, SIGNAL(fiscalReceiptNumber(int, int, int)));
             connect(dynamic_cast<DriverFiscalEpson *>(m_driverFiscal), SIGNAL(fiscalStatus(int)),
                     this, SIGNAL(fiscalStatus(int)));
+            connect(dynamic_cast<DriverFiscalEpson *>(m_driverFiscal), SIGNAL(statusChanged(int, int)),
+                    this, SIGNAL(statusChanged(int, int)));
         }
     } else {
         if (model == FiscalPrinter::Hasar1000F) {
-            m_driverFiscal = new DriverFiscalHasar2G(this, m_connector);
+            m_driverFiscal = new DriverFiscalHasar2G(0, m_connector);
             dynamic_cast<DriverFiscalHasar2G *>(m_driverFiscal)->setModel(model);
             connect(dynamic_cast<DriverFiscalHasar2G *>(m_driverFiscal), SIGNAL(fiscalReceiptNumber(int, int, int)),
                     this, SIGNAL(fiscalReceiptNumber(int, int, int)));
             connect(dynamic_cast<DriverFiscalHasar2G *>(m_driverFiscal), SIGNAL(fiscalStatus(int)),
                     this, SIGNAL(fiscalStatus(int)));
+            connect(dynamic_cast<DriverFiscalHasar2G *>(m_driverFiscal), SIGNAL(statusChanged(int, int)),
+                    this, SIGNAL(statusChanged(int, int)));
+
+            m_ioThread = ioThread;
+            if (!m_ioThread) {
+                m_ioThread = new QThread;
+                m_ownIoThread = true;
+                m_ioThread->start();
+            }
+            m_connector->moveToThread(m_ioThread);
+            dynamic_cast<DriverFiscalHasar2G *>(m_driverFiscal)->moveToThread(m_ioThread);
         } else {
             m_driverFiscal = new DriverFiscalHasar(this, m_connector, m_TIME_WAIT);
             dynamic_cast<DriverFiscalHasar *>(m_driverFiscal)->setModel(model);
@@ -92,6 +124,8 @@ FiscalPrinter::FiscalPrinter(QObject *parent, FiscalPrinter::Brand brand,
                     this, SIGNAL(fiscalReceiptNumber(int, int, int)));
             connect(dynamic_cast<DriverFiscalHasar *>(m_driverFiscal), SIGNAL(fiscalStatus(int)),
                     this, SIGNAL(fiscalStatus(int)));
+            connect(dynamic_cast<DriverFiscalHasar *>(m_driverFiscal), SIGNAL(statusChanged(int, int)),
+                    this, SIGNAL(statusChanged(int, int)));
         }
     }
 }
@@ -99,6 +133,19 @@ FiscalPrinter::FiscalPrinter(QObject *parent, FiscalPrinter::Brand brand,
 FiscalPrinter::~FiscalPrinter()
 {
     m_driverFiscal->finish();
+    delete m_journal;
+    if (m_ioThread) {
+        // deleted by their own thread, a finished thread still runs deferred deletes
+        dynamic_cast<QObject *>(m_driverFiscal)->deleteLater();
+        m_connector->deleteLater();
+        if (m_ownIoThread) {
+            m_ioThread->quit();
+            m_ioThread->wait();
+            delete m_ioThread;
+        }
+        return;
+    }
+
     if (m_connector) {
         if(m_connector->isOpen())
             m_connector->close();
@@ -119,6 +166,78 @@ bool FiscalPrinter::supportTicket()
     return false;
 }
 
+int FiscalPrinter::queueDepth()
+{
+    return m_driverFiscal->queueDepth();
+}
+
+int FiscalPrinter::status()
+{
+    return m_driverFiscal->status();
+}
+
+void FiscalPrinter::setWindow(const int frames)
+{
+    DriverFiscalEpsonExt *driver = dynamic_cast<DriverFiscalEpsonExt *>(m_driverFiscal);
+    if (driver)
+        driver->setWindow(frames);
+}
+
+bool FiscalPrinter::setJournal(const QString &path)
+{
+    if (m_journal)
+        return false;
+
+    CommandJournal *journal = new CommandJournal(path);
+    if (!journal->isOpen() || !m_driverFiscal->setJournal(journal)) {
+        delete journal;
+        return false;
+    }
+    m_journal = journal;
+    return true;
+}
+
+bool FiscalPrinter::setReceiptLedger(const QString &path)
+{
+    // a retry the driver can't void would be left open on the printer
+    if (m_ledger || !m_driverFiscal->canVoid())
+        return false;
+
+    ReceiptLedger *ledger = new ReceiptLedger(path, this);
+    if (!ledger->isOpen()) {
+        delete ledger;
+        return false;
+    }
+
+    // recorded in the driver's thread, before the reply of the close finishes
+    connect(dynamic_cast<QObject *>(m_driverFiscal), SIGNAL(fiscalReceiptNumber(int, int, int)),
+            ledger, SLOT(record(int, int, int)), Qt::DirectConnection);
+    m_ledger = ledger;
+    return true;
+}
+
+bool FiscalPrinter::setJournalIndex(const QString &path)
+{
+    if (m_index)
+        return false;
+
+    JournalIndex *index = new JournalIndex(path, this);
+    if (!index->isOpen()) {
+        delete index;
+        return false;
+    }
+
+    connect(dynamic_cast<QObject *>(m_driverFiscal), SIGNAL(fiscalReceiptNumber(int, int, int)),
+            index, SLOT(record(int, int, int)), Qt::DirectConnection);
+    m_index = index;
+    return true;
+}
+
+JournalIndex *FiscalPrinter::journalIndex() const
+{
+    return m_index;
+}
+
 bool FiscalPrinter::isOpen()
 {
     if (model() == FiscalPrinter::Hasar1000F)
@@ -127,292 +246,557 @@ bool FiscalPrinter::isOpen()
     return m_connector->isOpen();
 }
 
-void FiscalPrinter::statusRequest()
+FiscalReply FiscalPrinter::statusRequest(const int maxAge)
 {
 #ifdef DEBUG
-    log << "statusRequest()";
+    log << QString("statusRequest() %1").arg(maxAge);
 #endif
+    QMutexLocker locker(&m_statusMutex);
+
+    if(maxAge > 0) {
+        const FiscalReply cached = m_driverFiscal->cachedStatus(maxAge);
+        if(!cached.isNull())
+            return cached;
+    }
+
+    // its answer is not older than this call, no need for another one
+    if(!m_statusReply.isNull() && !m_statusReply.isFinished())
+        return m_statusReply;
+
+    const FiscalReply reply = begin();
     m_driverFiscal->statusRequest();
+    m_statusReply = end(reply);
+    return m_statusReply;
 }
 
-void FiscalPrinter::dailyClose(const char type)
+FiscalReply FiscalPrinter::dailyClose(const char type)
 {
 #ifdef DEBUG
     log << QString("dailyClose() %1").arg(type);
 #endif
+    const FiscalReply reply = begin();
     m_driverFiscal->dailyClose(type);
+    return end(reply);
 }
 
-void FiscalPrinter::dailyCloseByDate(const QDate &from, const QDate &to)
+FiscalReply FiscalPrinter::dailyCloseByDate(const QDate &from, const QDate &to)
 {
 #ifdef DEBUG
     log << QString("dailyCloseByDate() %1 %2").arg(from.toString()).arg(to.toString());
 #endif
+    const FiscalReply reply = begin();
     m_driverFiscal->dailyCloseByDate(from, to);
+    return end(reply);
 }
 
-void FiscalPrinter::dailyCloseByNumber(const int from, const int to)
+FiscalReply FiscalPrinter::dailyCloseByNumber(const int from, const int to)
 {
 #ifdef DEBUG
     log << QString("dailyCloseByNumber() %1 %2").arg(from).arg(to);
 #endif
+    const FiscalReply reply = begin();
     m_driverFiscal->dailyCloseByNumber(from, to);
+    return end(reply);
 }
 
-void FiscalPrinter::setCustomerData(const QString &name, const QString &cuit, const char tax_type,
+FiscalReply FiscalPrinter::setCustomerData(const QString &name, const QString &cuit, const char tax_type,
         const QString &doc_type, const QString &address)
 {
 #ifdef DEBUG
     log << QString("setCustomerData() %1 %2 %3 %4 %5").arg(name).arg(cuit).arg(tax_type).arg(doc_type).arg(address);
 #endif
+    const FiscalReply reply = begin();
     m_driverFiscal->setCustomerData(name, cuit, tax_type, doc_type, address);
+    return end(reply);
 }
 
-void FiscalPrinter::openFiscalReceipt(const char type)
+FiscalReply FiscalPrinter::openFiscalReceipt(const char type)
 {
 #ifdef DEBUG
     log << QString("openFiscalReceipt() %1").arg(type);
 #endif
+    settle();
+    const FiscalReply reply = begin();
     m_driverFiscal->openFiscalReceipt(type);
+    return end(reply);
 }
 
-void FiscalPrinter::printFiscalText(const QString &text)
+FiscalReply FiscalPrinter::printFiscalText(const QString &text)
 {
 #ifdef DEBUG
     log << QString("printFiscalText() %1").arg(text);
 #endif
+    const FiscalReply reply = begin();
     m_driverFiscal->printFiscalText(text);
+    return end(reply);
 }
 
-void FiscalPrinter::printLineItem(const QString &description, const qreal quantity,
+FiscalReply FiscalPrinter::printLineItem(const QString &description, const qreal quantity,
         const qreal price, const QString &tax, const char qualifier, const qreal excise)
 {
 #ifdef DEBUG
     log << QString("printLineItem() %1 %2 %3 %4 %5 %6").arg(description).arg(quantity).arg(price).arg(tax).arg(qualifier).arg(excise);
 #endif
+    const FiscalReply reply = begin();
     m_driverFiscal->printLineItem(description, quantity, price, tax, qualifier, excise);
+    return end(reply);
 }
 
-void FiscalPrinter::perceptions(const QString &desc, qreal tax_amount)
+FiscalReply FiscalPrinter::perceptions(const QString &desc, qreal tax_amount)
 {
 #ifdef DEBUG
     log << QString("perceptions() %1 %2").arg(desc).arg(tax_amount);
 #endif
+    const FiscalReply reply = begin();
     m_driverFiscal->perceptions(desc, tax_amount);
+    return end(reply);
 }
 
-void FiscalPrinter::subtotal(const char print)
+FiscalReply FiscalPrinter::subtotal(const char print)
 {
 #ifdef DEBUG
     log << QString("subtotal() %1").arg(print);
 #endif
+    const FiscalReply reply = begin();
     m_driverFiscal->subtotal(print);
+    return end(reply);
 }
 
-void FiscalPrinter::totalTender(const QString &description, const qreal amount, const char type)
+FiscalReply FiscalPrinter::totalTender(const QString &description, const qreal amount, const char type)
 {
 #ifdef DEBUG
     log << QString("totalTender() %1 %2 %3").arg(description).arg(amount).arg(type);
 #endif
+    const FiscalReply reply = begin();
     m_driverFiscal->totalTender(description, amount, type);
+    return end(reply);
 }
 
-void FiscalPrinter::generalDiscount(const QString &description, const qreal amount, const qreal tax_percent, const char type)
+FiscalReply FiscalPrinter::generalDiscount(const QString &description, const qreal amount, const qreal tax_percent, const char type)
 {
 #ifdef DEBUG
     log << QString("generalDiscount() %1 %2 %3 %4").arg(description).arg(amount).arg(tax_percent).arg(type);
 #endif
+    const FiscalReply reply = begin();
     m_driverFiscal->generalDiscount(description, amount, tax_percent, type);
+    return end(reply);
 }
 
-void FiscalPrinter::closeFiscalReceipt(const char intype, const char type, const int id)
+FiscalReply FiscalPrinter::closeFiscalReceipt(const char intype, const char type, const int id)
 {
 #ifdef DEBUG
     log << QString("closeFiscalReceipt() %1 %2 %3").arg(intype).arg(type).arg(id);
 #endif
+    QMutexLocker locker(&m_ledgerMutex);
+    const FiscalReply earlier = submitted(id);
+    if (!earlier.isNull()) {
+        // the document just built is a retry, void it instead of closing it,
+        // behind its own frames so it can't reach the one it repeats
+        const FiscalReply reply = begin();
+        m_driverFiscal->voidDocument();
+        end(reply);
+        return earlier;
+    }
+
+    const FiscalReply reply = begin();
     m_driverFiscal->closeFiscalReceipt(intype, type, id);
+    remember(id, reply);
+    return end(reply);
+}
+
+FiscalReply FiscalPrinter::printReceipt(const FiscalReceipt &receipt)
+{
+#ifdef DEBUG
+    log << QString("printReceipt() %1 steps").arg(receipt.steps().size());
+#endif
+    settle();
+    QMutexLocker locker(&m_ledgerMutex);
+    const FiscalReply earlier = submitted(receipt.id());
+    if (!earlier.isNull())
+        return earlier;
+
+    const FiscalReply reply = begin();
+    remember(receipt.id(), reply);
+    m_driverFiscal->printReceipt(receipt);
+    return end(reply);
 }
 
-void FiscalPrinter::openNonFiscalReceipt()
+FiscalReply FiscalPrinter::openNonFiscalReceipt()
 {
 #ifdef DEBUG
     log << QString("openNonFiscalReceipt()");
 #endif
+    const FiscalReply reply = begin();
     m_driverFiscal->openNonFiscalReceipt();
+    return end(reply);
 }
 
-void FiscalPrinter::printNonFiscalText(const QString &text)
+FiscalReply FiscalPrinter::printNonFiscalText(const QString &text)
 {
 #ifdef DEBUG
     log << QString("printNonFiscalText() %1").arg(text);
 #endif
 
+    const FiscalReply reply = begin();
     m_driverFiscal->printNonFiscalText(text);
+    return end(reply);
 }
 
-void FiscalPrinter::closeNonFiscalReceipt()
+FiscalReply FiscalPrinter::closeNonFiscalReceipt()
 {
 #ifdef DEBUG
     log << QString("closeNonFiscalReceipt() ");
 #endif
+    const FiscalReply reply = begin();
     m_driverFiscal->closeNonFiscalReceipt();
+    return end(reply);
 }
 
-void FiscalPrinter::openDrawer()
+FiscalReply FiscalPrinter::openDrawer()
 {
 #ifdef DEBUG
     log << QString("openDrawer() ");
 #endif
+    const FiscalReply reply = begin();
     m_driverFiscal->openDrawer();
+    return end(reply);
 }
 
-void FiscalPrinter::setHeaderTrailer(const QString &header, const QString &trailer)
+FiscalReply FiscalPrinter::setHeaderTrailer(const QString &header, const QString &trailer)
 {
 #ifdef DEBUG
     log << QString("setHeaderTrailer() %1 %2").arg(header).arg(trailer);
 #endif
+    const FiscalReply reply = begin();
     m_driverFiscal->setHeaderTrailer(header, trailer);
+    return end(reply);
 }
 
-void FiscalPrinter::setEmbarkNumber(const int doc_num, const QString &description, const char type)
+FiscalReply FiscalPrinter::setEmbarkNumber(const int doc_num, const QString &description, const char type)
 {
 #ifdef DEBUG
     log << QString("setEmbarkNumber() %1 %2 %3").arg(doc_num).arg(description).arg(type);
 #endif
+    const FiscalReply reply = begin();
     m_driverFiscal->setEmbarkNumber(doc_num, description, type);
+    return end(reply);
 }
 
-void FiscalPrinter::openDNFH(const char type, const char fix_value, const QString &doc_num)
+FiscalReply FiscalPrinter::openDNFH(const char type, const char fix_value, const QString &doc_num)
 {
 #ifdef DEBUG
     log << QString("openDNFH() %1 %2 %3").arg(type).arg(fix_value).arg(doc_num);
 #endif
+    settle();
+    const FiscalReply reply = begin();
     m_driverFiscal->openDNFH(type, fix_value, doc_num);
+    return end(reply);
 }
 
-void FiscalPrinter::printEmbarkItem(const QString &description, const qreal quantity)
+FiscalReply FiscalPrinter::printEmbarkItem(const QString &description, const qreal quantity)
 {
 #ifdef DEBUG
     log << QString("printEmbarkItem() %1 %2").arg(description).arg(quantity);
 #endif
+    const FiscalReply reply = begin();
     m_driverFiscal->printEmbarkItem(description, quantity);
+    return end(reply);
 }
 
-void FiscalPrinter::closeDNFH(const int id, const char f_type, const int copies)
+FiscalReply FiscalPrinter::closeDNFH(const int id, const char f_type, const int copies)
 {
 #ifdef DEBUG
     log << QString("closeDNFH() %1 %2 %3").arg(id).arg(f_type).arg(copies);
 #endif
+    QMutexLocker locker(&m_ledgerMutex);
+    const FiscalReply earlier = submitted(id);
+    if (!earlier.isNull()) {
+        const FiscalReply reply = begin();
+        m_driverFiscal->voidDocument();
+        end(reply);
+        return earlier;
+    }
+
+    const FiscalReply reply = begin();
     m_driverFiscal->closeDNFH(id, f_type, copies);
+    remember(id, reply);
+    return end(reply);
 }
 
-void FiscalPrinter::cancel()
+FiscalReply FiscalPrinter::cancel()
 {
 #ifdef DEBUG
     log << QString("cancel() ");
 #endif
+    const FiscalReply reply = begin();
     m_driverFiscal->cancel();
+    return end(reply);
 }
 
-void FiscalPrinter::ack()
+FiscalReply FiscalPrinter::ack()
 {
 #ifdef DEBUG
     log << QString("ask() ");
 #endif
+    const FiscalReply reply = begin();
     m_driverFiscal->ack();
+    return end(reply);
 }
 
-void FiscalPrinter::setDateTime(const QDateTime &dateTime)
+FiscalReply FiscalPrinter::setDateTime(const QDateTime &dateTime)
 {
 #ifdef DEBUG
     log << QString("setDateTime() %1").arg(dateTime.toString());
 #endif
+    const FiscalReply reply = begin();
     m_driverFiscal->setDateTime(dateTime);
+    return end(reply);
 }
 
-void FiscalPrinter::receiptText(const QString &text)
+FiscalReply FiscalPrinter::receiptText(const QString &text)
 {
 #ifdef DEBUG
     log << QString("receiptText() %1").arg(text);
 #endif
+    const FiscalReply reply = begin();
     m_driverFiscal->receiptText(text);
+    return end(reply);
 }
 
-void FiscalPrinter::reprintDocument(const QString &doc_type, const int doc_number)
+FiscalReply FiscalPrinter::reprintDocument(const QString &doc_type, const int doc_number)
 {
 #ifdef DEBUG
     log << QString("reprintDocument() %1 %2").arg(doc_type).arg(doc_number);
 #endif
+    const FiscalReply reply = begin();
     m_driverFiscal->reprintDocument(doc_type, doc_number);
+    return end(reply);
 }
 
-void FiscalPrinter::reprintContinue()
+FiscalReply FiscalPrinter::reprintContinue()
 {
 #ifdef DEBUG
     log << QString("reprintContinue() ");
 #endif
+    const FiscalReply reply = begin();
     m_driverFiscal->reprintContinue();
+    return end(reply);
 }
 
-void FiscalPrinter::reprintFinalize()
+FiscalReply FiscalPrinter::reprintFinalize()
 {
 #ifdef DEBUG
     log << QString("reprintFinalize() ");
 #endif
+    const FiscalReply reply = begin();
     m_driverFiscal->reprintFinalize();
+    return end(reply);
 }
 
-void FiscalPrinter::setFixedData(const QString &shop, const QString &phone)
+FiscalReply FiscalPrinter::setFixedData(const QString &shop, const QString &phone)
 {
 #ifdef DEBUG
     log << QString("setFixedData() %1 %2").arg(shop).arg(phone);
 #endif
+    const FiscalReply reply = begin();
     m_driverFiscal->setFixedData(shop, phone);
+    return end(reply);
 }
 
-void FiscalPrinter::getTransactionalMemoryInfo()
+FiscalReply FiscalPrinter::getTransactionalMemoryInfo()
 {
 #ifdef DEBUG
     log << QString("getTransactionalMemoryInfo()");
 #endif
+    const FiscalReply reply = begin();
     m_driverFiscal->getTransactionalMemoryInfo();
+    return end(reply);
 }
 
-void FiscalPrinter::downloadReportByDate(const QString &type, const QDate &from, const QDate &to)
+FiscalReply FiscalPrinter::downloadReportByDate(const QString &type, const QDate &from, const QDate &to)
 {
 #ifdef DEBUG
     log << QString("downloadReportByDate() %1 %2 %3").arg(type).arg(from.toString()).arg(to.toString());
 #endif
+    const FiscalReply reply = begin();
     m_driverFiscal->downloadReportByDate(type, from, to);
+    return end(reply);
 }
 
-void FiscalPrinter::downloadReportByNumber(const QString &type, const int from, const int to)
+FiscalReply FiscalPrinter::downloadReportByNumber(const QString &type, const int from, const int to)
 {
 #ifdef DEBUG
     log << QString("downloadReportByNumber() %1 %2 %3").arg(type).arg(from).arg(to);
 #endif
+    const FiscalReply reply = begin();
+    m_driverFiscal->downloadReportByNumber(type, from, to);
+    return end(reply);
+}
+
+FiscalReply FiscalPrinter::downloadReportByDate(const QString &type, const QDate &from, const QDate &to, QIODevice *sink)
+{
+#ifdef DEBUG
+    log << QString("downloadReportByDate() %1 %2 %3 streaming").arg(type).arg(from.toString()).arg(to.toString());
+#endif
+    if (!m_driverFiscal->setDownloadSink(sink)) {
+        FiscalReply reply = FiscalReply::create();
+        reply.complete(false);
+        return reply;
+    }
+
+    const FiscalReply reply = begin();
+    m_driverFiscal->downloadReportByDate(type, from, to);
+    return end(reply);
+}
+
+FiscalReply FiscalPrinter::downloadReportByNumber(const QString &type, const int from, const int to, QIODevice *sink)
+{
+#ifdef DEBUG
+    log << QString("downloadReportByNumber() %1 %2 %3 streaming").arg(type).arg(from).arg(to);
+#endif
+    if (!m_driverFiscal->setDownloadSink(sink)) {
+        FiscalReply reply = FiscalReply::create();
+        reply.complete(false);
+        return reply;
+    }
+
+    const FiscalReply reply = begin();
     m_driverFiscal->downloadReportByNumber(type, from, to);
+    return end(reply);
 }
 
-void FiscalPrinter::downloadContinue()
+FiscalReply FiscalPrinter::downloadContinue()
 {
 #ifdef DEBUG
     log << QString("downloadContinue()");
 #endif
+    const FiscalReply reply = begin();
     m_driverFiscal->downloadContinue();
+    return end(reply);
 }
 
-void FiscalPrinter::downloadFinalize()
+FiscalReply FiscalPrinter::downloadFinalize()
 {
 #ifdef DEBUG
     log << QString("downloadFinalize()");
 #endif
+    const FiscalReply reply = begin();
     m_driverFiscal->downloadFinalize();
+    return end(reply);
 }
 
-void FiscalPrinter::downloadDelete(const int to)
+FiscalReply FiscalPrinter::downloadDelete(const int to)
 {
 #ifdef DEBUG
     log << QString("downloadDelete() %1").arg(to);
 #endif
+
+    // nothing to send yet
+    FiscalReply reply = FiscalReply::create();
+    reply.complete(true);
+    return reply;
+}
+
+FiscalReply FiscalPrinter::submitted(const int id)
+{
+    if (!m_ledger || id < 0)
+        return FiscalReply();
+
+    const int number = m_ledger->number(id);
+    if (number >= 0) {
+#ifdef DEBUG
+        log << QString("submitted() -> receipt %1 already printed as %2").arg(id).arg(number);
+#endif
+        FiscalReply reply = FiscalReply::create();
+        reply.setValue(number);
+        reply.complete(true);
+        return reply;
+    }
+
+    // still on its way, or failed and not yet shown by settle() to be unprinted
+    return m_submitted.value(id);
+}
+
+void FiscalPrinter::remember(const int id, const FiscalReply &reply)
+{
+    if (!m_ledger || id < 0)
+        return;
+
+    // a failed one stays until settle() tells whether it printed
+    QMutableHashIterator<int, FiscalReply> i(m_submitted);
+    while (i.hasNext()) {
+        if (i.next().value().isOk())
+            i.remove();
+    }
+    m_submitted.insert(id, reply);
+}
+
+void FiscalPrinter::settle()
+{
+    QMutexLocker locker(&m_ledgerMutex);
+    if (!m_ledger)
+        return;
+
+    QList<int> failed;
+    QHash<int, FiscalReply>::const_iterator i;
+    for (i = m_submitted.constBegin(); i != m_submitted.constEnd(); ++i) {
+        if (i.value().isFinished() && !i.value().isOk() && !m_doubtful.contains(i.key()))
+            failed.append(i.key());
+    }
+    if (failed.isEmpty())
+        return;
+
+    // Asked before this document is queued, so an open document can only
+    // be the one the failed close was meant to finish. The other closes
+    // don't wait on the answer.
+    locker.unlock();
+    const FiscalReply status = statusRequest();
+    if (!status.waitForFinished(SETTLE_WAIT) || !status.isOk())
+        return; // printer busy or unreachable, settled before the next document
+    locker.relock();
+
+    const bool open = m_driverFiscal->status() & (FiscalDocumentOpen | DocumentOpen);
+    bool settled = false;
+    for (int j = 0; j < failed.size(); j++) {
+        const int id = failed.at(j);
+        // another caller may have settled it meanwhile
+        if (!m_submitted.contains(id) || m_doubtful.contains(id))
+            continue;
+        settled = true;
+        if (open) {
+            // the close never ran, the receipt is free to go again
+            m_submitted.remove(id);
+        } else {
+            // closed or voided, from here it can't be told which, and a
+            // second fiscal receipt is worse than a missing one
+            m_doubtful.append(id);
+        }
+#ifdef DEBUG
+        log << QString("settle() -> receipt %1 %2").arg(id).arg(open ? "not printed" : "may have printed");
+#endif
+    }
+
+    // only the most recent ones are still retried by a POS
+    while (m_doubtful.size() > MAX_DOUBTFUL)
+        m_submitted.remove(m_doubtful.takeFirst());
+
+    if (open && settled) {
+        // what is left of it would take the retry's frames in
+        const FiscalReply reply = begin();
+        m_driverFiscal->cancel();
+        end(reply);
+    }
+}
+
+FiscalReply FiscalPrinter::begin()
+{
+    const FiscalReply reply = FiscalReply::create();
+    m_driverFiscal->beginBatch(reply);
+    return reply;
+}
+
+FiscalReply FiscalPrinter::end(const FiscalReply &reply)
+{
+    m_driverFiscal->endBatch();
+    return reply;
 }
@@ -40,6 +40,15 @@
 #include "connector.h"
 #include "driverfiscal.h"
 
+#include <QHash>
+#include <QList>
+
+class QThread;
+class QIODevice;
+class CommandJournal;
+class ReceiptLedger;
+class JournalIndex;
+
 class FiscalPrinter : public QObject
 {
     Q_OBJECT
@@ -72,69 +81,132 @@ public:
     };
     Q_DECLARE_FLAGS(States, State)
 
+    enum StatusFlag {
+        PrinterError            = 0x0001,
+        PrinterOffline          = 0x0002,
+        PaperLow                = 0x0004,
+        PaperOut                = 0x0008,
+        CoverOpen               = 0x0010,
+        DrawerOpen              = 0x0020,
+        FiscalMemoryError       = 0x0040,
+        FiscalMemoryNearFull    = 0x0080,
+        FiscalMemoryFull        = 0x0100,
+        FiscalDocumentOpen      = 0x0200,
+        DocumentOpen            = 0x0400
+    };
+    Q_DECLARE_FLAGS(StatusFlags, StatusFlag)
+
 
     FiscalPrinter(QObject *parent = 0, FiscalPrinter::Brand brand = Epson,
             FiscalPrinter::Model model = EpsonTMU220, const QString &port_type = "COM",
-            const QString &port = "1", const QString &settings = "", int m_TIME_WAIT = 300);
+            const QString &port = "1", const QString &settings = "", int m_TIME_WAIT = 300,
+            QThread *ioThread = 0); // Hasar1000F only, see FiscalPrinterPool
 
     ~FiscalPrinter();
     int model();
     bool isOpen();
     bool supportTicket();
+    int queueDepth(); // commands waiting to be sent
+    int status(); // last known StatusFlags, no round trip
+    void setWindow(const int frames); // frames in flight, EpsonTM900 only
+    // Journal of the open document in path. A document left open by a crash
+    // is finished or voided before the next command. Hasar serial only.
+    bool setJournal(const QString &path);
+    // Receipt ids already printed, kept in path. A receipt submitted again
+    // with one of them is not printed twice, its reply carries the number
+    // it got the first time. One whose close failed is printed again only
+    // if the printer still had its document open, else its reply stays failed.
+    // False on printers whose documents can't be voided (EpsonTM900).
+    bool setReceiptLedger(const QString &path);
+    // Electronic journal index kept in path. Documents printed are indexed
+    // by day, DownloadJob files the reports it downloads in it.
+    bool setJournalIndex(const QString &path);
+    JournalIndex *journalIndex() const;
 
     /* commands */
-    void statusRequest();
-    void dailyClose(const char type);
-    void dailyCloseByDate(const QDate &form, const QDate &to);
-    void dailyCloseByNumber(const int from, const int to);
-    void setCustomerData(const QString &name, const QString &cuit, const char tax_type,
+    // maxAge > 0 may answer from the status the last reply carried
+    FiscalReply statusRequest(const int maxAge = 0);
+    FiscalReply dailyClose(const char type);
+    FiscalReply dailyCloseByDate(const QDate &form, const QDate &to);
+    FiscalReply dailyCloseByNumber(const int from, const int to);
+    FiscalReply setCustomerData(const QString &name, const QString &cuit, const char tax_type,
             const QString &doc_type, const QString &address);
-    void openFiscalReceipt(const char type);
-    void printFiscalText(const QString &text);
-    void printLineItem(const QString &description, const qreal quantity,
+    FiscalReply openFiscalReceipt(const char type);
+    FiscalReply printFiscalText(const QString &text);
+    FiscalReply printLineItem(const QString &description, const qreal quantity,
             const qreal price, const QString &tax, const char qualifier, const qreal excise = 0);
-    void perceptions(const QString &desc, qreal tax_amount);
-    void subtotal(const char print);
-    void totalTender(const QString &description, const qreal amount, const char type);
-    void generalDiscount(const QString &description, const qreal amount, const qreal tax_percent, const char type);
-    void closeFiscalReceipt(const char intype, const char type, const int id);
-    void openNonFiscalReceipt();
-    void printNonFiscalText(const QString &text);
-    void closeNonFiscalReceipt();
-    void openDrawer();
-    void setHeaderTrailer(const QString &header, const QString &trailer);
-    void setEmbarkNumber(const int doc_num, const QString &description, const char type = ' ');
-    void openDNFH(const char type, const char fix_value, const QString  &doc_num);
-    void printEmbarkItem(const QString &description, const qreal quantity);
-    void closeDNFH(const int id, const char f_type, const int copies);
-    void receiptText(const QString &text);
-    void reprintDocument(const QString &doc_type, const int doc_number);
-    void reprintContinue();
-    void reprintFinalize();
-    void cancel();
-    void ack();
-    void setDateTime(const QDateTime &dateTime);
-    void setFixedData(const QString &shop, const QString &phone);
-
-    void getTransactionalMemoryInfo();
-    void downloadReportByDate(const QString &type, const QDate &form, const QDate &to);
-    void downloadReportByNumber(const QString &type, const int from, const int to);
-    void downloadContinue();
-    void downloadFinalize();
-    void downloadDelete(const int to);
+    FiscalReply perceptions(const QString &desc, qreal tax_amount);
+    FiscalReply subtotal(const char print);
+    FiscalReply totalTender(const QString &description, const qreal amount, const char type);
+    FiscalReply generalDiscount(const QString &description, const qreal amount, const qreal tax_percent, const char type);
+    FiscalReply closeFiscalReceipt(const char intype, const char type, const int id);
+    FiscalReply openNonFiscalReceipt();
+    FiscalReply printNonFiscalText(const QString &text);
+    FiscalReply closeNonFiscalReceipt();
+    FiscalReply openDrawer();
+    FiscalReply setHeaderTrailer(const QString &header, const QString &trailer);
+    FiscalReply setEmbarkNumber(const int doc_num, const QString &description, const char type = ' ');
+    FiscalReply openDNFH(const char type, const char fix_value, const QString  &doc_num);
+    FiscalReply printEmbarkItem(const QString &description, const qreal quantity);
+    FiscalReply closeDNFH(const int id, const char f_type, const int copies);
+    FiscalReply receiptText(const QString &text);
+    FiscalReply reprintDocument(const QString &doc_type, const int doc_number);
+    FiscalReply reprintContinue();
+    FiscalReply reprintFinalize();
+    FiscalReply cancel();
+    FiscalReply ack();
+    FiscalReply setDateTime(const QDateTime &dateTime);
+    FiscalReply setFixedData(const QString &shop, const QString &phone);
+
+    FiscalReply getTransactionalMemoryInfo();
+    FiscalReply downloadReportByDate(const QString &type, const QDate &form, const QDate &to);
+    FiscalReply downloadReportByNumber(const QString &type, const int from, const int to);
+    // Streams the whole report into sink, written from the driver's thread;
+    // the reply finishes with the bytes written. EpsonTM900 only.
+    FiscalReply downloadReportByDate(const QString &type, const QDate &from, const QDate &to, QIODevice *sink);
+    FiscalReply downloadReportByNumber(const QString &type, const int from, const int to, QIODevice *sink);
+    FiscalReply downloadContinue();
+    FiscalReply downloadFinalize();
+    FiscalReply downloadDelete(const int to);
+
+    FiscalReply printReceipt(const FiscalReceipt &receipt);
 
 signals:
     void fiscalReceiptNumber(int, int, int);
     void fiscalStatus(int);
     void fiscalData(int, QVariant);
+    void statusChanged(int, int); // StatusFlags now, and the ones that changed
+    void downloadProgress(qint64); // bytes written to the sink so far
 
 private:
+    // every command goes out as a batch tied to its own reply
+    FiscalReply begin();
+    FiscalReply end(const FiscalReply &reply);
+    // reply of an earlier submission of id, null if this is the first one
+    FiscalReply submitted(const int id);
+    void remember(const int id, const FiscalReply &reply);
+    // Before a document goes out, asks the printer about the closes that
+    // failed: one whose document is still open is voided and may be retried,
+    // any other stays failed since it may have printed
+    void settle();
+
     Connector *m_connector;
     DriverFiscal *m_driverFiscal;
+    QThread *m_ioThread; // Hasar1000F: driver and connector live there
+    bool m_ownIoThread;
+    CommandJournal *m_journal;
+    ReceiptLedger *m_ledger;
+    JournalIndex *m_index;
+    QMutex m_ledgerMutex;
+    QHash<int, FiscalReply> m_submitted; // by receipt id, until printed or settled
+    QList<int> m_doubtful; // failed closes that may have printed, oldest first
     int m_model;
+    QMutex m_statusMutex;
+    FiscalReply m_statusReply; // in flight, shared by concurrent callers
 };
 
 Q_DECLARE_OPERATORS_FOR_FLAGS(FiscalPrinter::Brands)
 Q_DECLARE_OPERATORS_FOR_FLAGS(FiscalPrinter::Models)
+Q_DECLARE_OPERATORS_FOR_FLAGS(FiscalPrinter::StatusFlags)
 
 #endif // FISCALPRINTER_H
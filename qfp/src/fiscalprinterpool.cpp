@@ -0,0 +1,92 @@
+/*
+*
+* Copyright (C)2018, Samuel Isuani <sisuani@gmail.com>
+* All rights reserved.
+*
+* Redistribution and use in source and binary forms, with or without
+* modification, are permitted provided that the following conditions
+* are met:
+*
+* Redistributions of source code must retain the above copyright notice,
+* this list of conditions and the following disclaimer.
+*
+* Redistributions in binary form must reproduce the above copyright
+* notice, this list of conditions and the following disclaimer in the
+* documentation and/or other materials provided with the distribution.
+*
+* Neither the name of the project's author nor the names of its
+* contributors may be used to endorse or promote products derived from
+* this software without specific prior written permission.
+*
+* THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+* "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+* LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+* FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+* HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+* SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED
+* TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+* PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+* LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+* NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+* SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*
+*/
+
+
+#include "fiscalprinterpool.h"
+#include "logger.h"
+
+#include <QThread>
+
+FiscalPrinterPool::FiscalPrinterPool(QObject *parent)
+    : QObject(parent)
+{
+    m_ioThread = new QThread(this);
+    m_ioThread->start();
+}
+
+FiscalPrinterPool::~FiscalPrinterPool()
+{
+    // the printers hand their drivers back to m_ioThread for deletion
+    qDeleteAll(m_printers);
+    m_printers.clear();
+    m_ioThread->quit();
+    m_ioThread->wait();
+}
+
+FiscalPrinter *FiscalPrinterPool::addPrinter(const QString &name, FiscalPrinter::Brand brand,
+        FiscalPrinter::Model model, const QString &port_type, const QString &port,
+        const QString &settings, int m_TIME_WAIT)
+{
+    if (m_printers.contains(name))
+        return 0;
+
+#ifdef DEBUG
+    log << QString("FiscalPrinterPool::addPrinter() %1").arg(name);
+#endif
+
+    FiscalPrinter *printer = new FiscalPrinter(this, brand, model, port_type, port,
+            settings, m_TIME_WAIT, m_ioThread);
+    m_printers.insert(name, printer);
+    return printer;
+}
+
+void FiscalPrinterPool::removePrinter(const QString &name)
+{
+    delete m_printers.take(name);
+}
+
+FiscalPrinter *FiscalPrinterPool::printer(const QString &name) const
+{
+    return m_printers.value(name);
+}
+
+QStringList FiscalPrinterPool::names() const
+{
+    return m_printers.keys();
+}
+
+int FiscalPrinterPool::count() const
+{
+    return m_printers.size();
+}
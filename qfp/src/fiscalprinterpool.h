@@ -0,0 +1,77 @@
+/*
+*
+* Copyright (C)2018, Samuel Isuani <sisuani@gmail.com>
+* All rights reserved.
+*
+* Redistribution and use in source and binary forms, with or without
+* modification, are permitted provided that the following conditions
+* are met:
+*
+* Redistributions of source code must retain the above copyright notice,
+* this list of conditions and the following disclaimer.
+*
+* Redistributions in binary form must reproduce the above copyright
+* notice, this list of conditions and the following disclaimer in the
+* documentation and/or other materials provided with the distribution.
+*
+* Neither the name of the project's author nor the names of its
+* contributors may be used to endorse or promote products derived from
+* this software without specific prior written permission.
+*
+* THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+* "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+* LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+* FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+* HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+* SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED
+* TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+* PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+* LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+* NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+* SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*
+*/
+
+
+#ifndef FISCALPRINTERPOOL_H
+#define FISCALPRINTERPOOL_H
+
+#include <QObject>
+#include <QMap>
+#include <QStringList>
+
+#include "fiscalprinter.h"
+
+class QThread;
+
+// Owns the printers of a store, one per lane, by name.
+//
+// Only the Hasar 2G network drivers (Hasar1000F) are driven from its single
+// I/O thread, with no thread of their own. Every serial printer (Epson,
+// TM-900, Hasar) still costs a worker thread blocking on its port: their
+// drivers are written as blocking send / read loops and are not reactor
+// callbacks, so a pool of serial lanes grows by one thread per lane.
+class FiscalPrinterPool : public QObject
+{
+    Q_OBJECT
+
+public:
+    explicit FiscalPrinterPool(QObject *parent = 0);
+    ~FiscalPrinterPool();
+
+    // 0 if name is already taken
+    FiscalPrinter *addPrinter(const QString &name, FiscalPrinter::Brand brand,
+            FiscalPrinter::Model model, const QString &port_type, const QString &port,
+            const QString &settings = "", int m_TIME_WAIT = 300);
+    void removePrinter(const QString &name);
+
+    FiscalPrinter *printer(const QString &name) const;
+    QStringList names() const;
+    int count() const;
+
+private:
+    QThread *m_ioThread;
+    QMap<QString, FiscalPrinter *> m_printers;
+};
+
+#endif // FISCALPRINTERPOOL_H
@@ -0,0 +1,142 @@
+/*
+*
+* Copyright (C)2018, Samuel Isuani <sisuani@gmail.com>
+* All rights reserved.
+*
+* Redistribution and use in source and binary forms, with or without
+* modification, are permitted provided that the following conditions
+* are met:
+*
+* Redistributions of source code must retain the above copyright notice,
+* this list of conditions and the following disclaimer.
+*
+* Redistributions in binary form must reproduce the above copyright
+* notice, this list of conditions and the following disclaimer in the
+* documentation and/or other materials provided with the distribution.
+*
+* Neither the name of the project's author nor the names of its
+* contributors may be used to endorse or promote products derived from
+* this software without specific prior written permission.
+*
+* THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+* "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+* LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+* FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+* HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+* SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED
+* TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+* PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+* LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+* NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+* SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*
+*/
+
+
+#include "fiscalreceipt.h"
+
+FiscalReceipt::FiscalReceipt()
+{
+}
+
+FiscalReceipt::Step &FiscalReceipt::append(Command command)
+{
+    m_steps.append(Step());
+    Step &step = m_steps.last();
+    step.command = command;
+    return step;
+}
+
+void FiscalReceipt::setCustomerData(const QString &name, const QString &cuit, const char tax_type,
+        const QString &doc_type, const QString &address)
+{
+    Step &s = append(CustomerData);
+    s.text = name;
+    s.text2 = cuit;
+    s.code = tax_type;
+    s.text3 = doc_type;
+    s.text4 = address;
+}
+
+void FiscalReceipt::openFiscalReceipt(const char type)
+{
+    append(Open).code = type;
+}
+
+void FiscalReceipt::printFiscalText(const QString &text)
+{
+    append(FiscalText).text = text;
+}
+
+void FiscalReceipt::printLineItem(const QString &description, const qreal quantity,
+        const qreal price, const QString &tax, const char qualifier, const qreal excise)
+{
+    Step &s = append(LineItem);
+    s.text = description;
+    s.value = quantity;
+    s.value2 = price;
+    s.text2 = tax;
+    s.code = qualifier;
+    s.value3 = excise;
+}
+
+void FiscalReceipt::perceptions(const QString &desc, qreal tax_amount)
+{
+    Step &s = append(Perceptions);
+    s.text = desc;
+    s.value = tax_amount;
+}
+
+void FiscalReceipt::subtotal(const char print)
+{
+    append(Subtotal).code = print;
+}
+
+void FiscalReceipt::generalDiscount(const QString &description, const qreal amount, const qreal tax_percent, const char type)
+{
+    Step &s = append(GeneralDiscount);
+    s.text = description;
+    s.value = amount;
+    s.value2 = tax_percent;
+    s.code = type;
+}
+
+void FiscalReceipt::totalTender(const QString &description, const qreal amount, const char type)
+{
+    Step &s = append(TotalTender);
+    s.text = description;
+    s.value = amount;
+    s.code = type;
+}
+
+void FiscalReceipt::closeFiscalReceipt(const char intype, const char type, const int id)
+{
+    Step &s = append(Close);
+    s.code = intype;
+    s.code2 = type;
+    s.id = id;
+}
+
+bool FiscalReceipt::isEmpty() const
+{
+    return m_steps.isEmpty();
+}
+
+int FiscalReceipt::id() const
+{
+    for (int i = 0; i < m_steps.size(); i++) {
+        if (m_steps.at(i).command == Close)
+            return m_steps.at(i).id;
+    }
+    return -1;
+}
+
+void FiscalReceipt::clear()
+{
+    m_steps.clear();
+}
+
+const QVector<FiscalReceipt::Step> &FiscalReceipt::steps() const
+{
+    return m_steps;
+}
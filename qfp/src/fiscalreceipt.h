@@ -0,0 +1,104 @@
+/*
+*
+* Copyright (C)2018, Samuel Isuani <sisuani@gmail.com>
+* All rights reserved.
+*
+* Redistribution and use in source and binary forms, with or without
+* modification, are permitted provided that the following conditions
+* are met:
+*
+* Redistributions of source code must retain the above copyright notice,
+* this list of conditions and the following disclaimer.
+*
+* Redistributions in binary form must reproduce the above copyright
+* notice, this list of conditions and the following disclaimer in the
+* documentation and/or other materials provided with the distribution.
+*
+* Neither the name of the project's author nor the names of its
+* contributors may be used to endorse or promote products derived from
+* this software without specific prior written permission.
+*
+* THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+* "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+* LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+* FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+* HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+* SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED
+* TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+* PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+* LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+* NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+* SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*
+*/
+
+
+#ifndef FISCALRECEIPT_H
+#define FISCALRECEIPT_H
+
+#include <QString>
+#include <QVector>
+
+// A whole fiscal document, filled in by the caller and handed to
+// FiscalPrinter::printReceipt(). The driver queues all of its frames at once.
+class FiscalReceipt
+{
+
+public:
+    enum Command {
+        CustomerData,
+        Open,
+        FiscalText,
+        LineItem,
+        Perceptions,
+        Subtotal,
+        GeneralDiscount,
+        TotalTender,
+        Close
+    };
+
+    // One call with its arguments as they were given, typed so the driver
+    // builds the package straight from them. Which fields are used depends
+    // on the command, the rest keep their defaults.
+    struct Step {
+        Step() : value(0), value2(0), value3(0), code(0), code2(0), id(-1) {}
+
+        Command command;
+        QString text;   // name, description, text
+        QString text2;  // cuit, tax
+        QString text3;  // doc_type
+        QString text4;  // address
+        qreal value;    // quantity, amount, tax_amount
+        qreal value2;   // price, tax_percent
+        qreal value3;   // excise
+        char code;      // tax_type, type, qualifier, print, intype
+        char code2;     // type of the close
+        int id;
+    };
+
+    FiscalReceipt();
+
+    void setCustomerData(const QString &name, const QString &cuit, const char tax_type,
+            const QString &doc_type, const QString &address);
+    void openFiscalReceipt(const char type);
+    void printFiscalText(const QString &text);
+    void printLineItem(const QString &description, const qreal quantity,
+            const qreal price, const QString &tax, const char qualifier, const qreal excise = 0);
+    void perceptions(const QString &desc, qreal tax_amount);
+    void subtotal(const char print);
+    void generalDiscount(const QString &description, const qreal amount, const qreal tax_percent, const char type);
+    void totalTender(const QString &description, const qreal amount, const char type);
+    void closeFiscalReceipt(const char intype, const char type, const int id);
+
+    bool isEmpty() const;
+    void clear();
+    int id() const; // the id given to closeFiscalReceipt(), -1 if none
+    const QVector<Step> &steps() const;
+
+private:
+    Step &append(Command command);
+
+    QVector<Step> m_steps; // one block for the whole document
+};
+
+#endif // FISCALRECEIPT_H
@@ -0,0 +1,220 @@
+/*
+*
+* Copyright (C)2018, Samuel Isuani <sisuani@gmail.com>
+* All rights reserved.
+*
+* Redistribution and use in source and binary forms, with or without
+* modification, are permitted provided that the following conditions
+* are met:
+*
+* Redistributions of source code must retain the above copyright notice,
+* this list of conditions and the following disclaimer.
+*
+* Redistributions in binary form must reproduce the above copyright
+* notice, this list of conditions and the following disclaimer in the
+* documentation and/or other materials provided with the distribution.
+*
+* Neither the name of the project's author nor the names of its
+* contributors may be used to endorse or promote products derived from
+* this software without specific prior written permission.
+*
+* THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+* "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+* LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+* FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+* HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+* SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED
+* TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+* PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+* LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+* NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+* SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*
+*/
+
+
+#include "fiscalreply.h"
+
+#include <QMutex>
+#include <QMutexLocker>
+#include <QTime>
+#include <QWaitCondition>
+
+class FiscalReplyData
+{
+
+public:
+    FiscalReplyData()
+        : pending(0)
+        , finished(false)
+        , ok(true)
+        , printerStatus(0)
+        , fiscalStatus(0)
+        , elapsed(0)
+    {
+        timer.start();
+    }
+
+    void finish(bool result)
+    {
+        ok = ok && result;
+        finished = true;
+        elapsed = timer.elapsed();
+        done.wakeAll();
+    }
+
+    mutable QMutex mutex;
+    QWaitCondition done;
+    QTime timer;
+
+    int pending;
+    bool finished;
+    bool ok;
+    int printerStatus;
+    int fiscalStatus;
+    QByteArray data;
+    QVariant value;
+    int elapsed;
+};
+
+FiscalReply::FiscalReply()
+{
+}
+
+FiscalReply FiscalReply::create()
+{
+    FiscalReply reply;
+    reply.d = QSharedPointer<FiscalReplyData>(new FiscalReplyData);
+    return reply;
+}
+
+bool FiscalReply::isNull() const
+{
+    return d.isNull();
+}
+
+bool FiscalReply::isFinished() const
+{
+    if (!d)
+        return true;
+    QMutexLocker locker(&d->mutex);
+    return d->finished;
+}
+
+bool FiscalReply::isOk() const
+{
+    if (!d)
+        return false;
+    QMutexLocker locker(&d->mutex);
+    return d->finished && d->ok;
+}
+
+int FiscalReply::pending() const
+{
+    if (!d)
+        return 0;
+    QMutexLocker locker(&d->mutex);
+    return d->pending;
+}
+
+int FiscalReply::printerStatus() const
+{
+    if (!d)
+        return 0;
+    QMutexLocker locker(&d->mutex);
+    return d->printerStatus;
+}
+
+int FiscalReply::fiscalStatus() const
+{
+    if (!d)
+        return 0;
+    QMutexLocker locker(&d->mutex);
+    return d->fiscalStatus;
+}
+
+QByteArray FiscalReply::data() const
+{
+    if (!d)
+        return QByteArray();
+    QMutexLocker locker(&d->mutex);
+    return d->data;
+}
+
+QVariant FiscalReply::value() const
+{
+    if (!d)
+        return QVariant();
+    QMutexLocker locker(&d->mutex);
+    return d->value;
+}
+
+int FiscalReply::elapsed() const
+{
+    if (!d)
+        return 0;
+    QMutexLocker locker(&d->mutex);
+    return d->finished ? d->elapsed : d->timer.elapsed();
+}
+
+bool FiscalReply::waitForFinished(unsigned long msecs) const
+{
+    if (!d)
+        return true;
+    QMutexLocker locker(&d->mutex);
+    while (!d->finished) {
+        if (!d->done.wait(&d->mutex, msecs))
+            return d->finished;
+    }
+    return true;
+}
+
+void FiscalReply::attach(int frames)
+{
+    if (!d)
+        return;
+    QMutexLocker locker(&d->mutex);
+    d->pending += frames;
+}
+
+void FiscalReply::setStatus(int printer, int fiscal)
+{
+    if (!d)
+        return;
+    QMutexLocker locker(&d->mutex);
+    d->printerStatus = printer;
+    d->fiscalStatus = fiscal;
+}
+
+void FiscalReply::setValue(const QVariant &value)
+{
+    if (!d)
+        return;
+    QMutexLocker locker(&d->mutex);
+    d->value = value;
+}
+
+void FiscalReply::complete(bool ok, const QByteArray &data)
+{
+    if (!d)
+        return;
+    QMutexLocker locker(&d->mutex);
+    if (d->finished)
+        return;
+
+    if (!data.isEmpty())
+        d->data = data;
+    if (d->pending > 0)
+        d->pending--;
+    if (!ok || d->pending == 0)
+        d->finish(ok);
+}
+
+void FiscalReply::cancel()
+{
+    if (!d)
+        return;
+    QMutexLocker locker(&d->mutex);
+    if (!d->finished)
+        d->finish(false);
+}
@@ -0,0 +1,80 @@
+/*
+*
+* Copyright (C)2018, Samuel Isuani <sisuani@gmail.com>
+* All rights reserved.
+*
+* Redistribution and use in source and binary forms, with or without
+* modification, are permitted provided that the following conditions
+* are met:
+*
+* Redistributions of source code must retain the above copyright notice,
+* this list of conditions and the following disclaimer.
+*
+* Redistributions in binary form must reproduce the above copyright
+* notice, this list of conditions and the following disclaimer in the
+* documentation and/or other materials provided with the distribution.
+*
+* Neither the name of the project's author nor the names of its
+* contributors may be used to endorse or promote products derived from
+* this software without specific prior written permission.
+*
+* THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+* "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+* LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+* FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+* HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+* SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED
+* TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+* PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+* LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+* NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+* SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*
+*/
+
+
+#ifndef FISCALREPLY_H
+#define FISCALREPLY_H
+
+#include <QByteArray>
+#include <QSharedPointer>
+#include <QVariant>
+
+#include <limits.h>
+
+class FiscalReplyData;
+
+// Handle to the result of one FiscalPrinter command. Copies share the same
+// state; it finishes once every frame queued by the command was answered,
+// or as soon as one of them fails or is dropped.
+class FiscalReply
+{
+
+public:
+    FiscalReply();
+    static FiscalReply create();
+
+    bool isNull() const;
+    bool isFinished() const;
+    bool isOk() const;
+    int pending() const;            // frames still waiting for an answer
+    int printerStatus() const;
+    int fiscalStatus() const;
+    QByteArray data() const;        // last raw reply
+    QVariant value() const;         // parsed result, e.g. the receipt number
+    int elapsed() const;            // ms from submission to completion
+
+    bool waitForFinished(unsigned long msecs = ULONG_MAX) const;
+
+    // driver side
+    void attach(int frames = 1);
+    void setStatus(int printer, int fiscal);
+    void setValue(const QVariant &value);
+    void complete(bool ok, const QByteArray &data = QByteArray());
+    void cancel();
+
+private:
+    QSharedPointer<FiscalReplyData> d;
+};
+
+#endif // FISCALREPLY_H
@@ -0,0 +1,188 @@
+/*
+*
+* Copyright (C)2018, Samuel Isuani <sisuani@gmail.com>
+* All rights reserved.
+*
+* Redistribution and use in source and binary forms, with or without
+* modification, are permitted provided that the following conditions
+* are met:
+*
+* Redistributions of source code must retain the above copyright notice,
+* this list of conditions and the following disclaimer.
+*
+* Redistributions in binary form must reproduce the above copyright
+* notice, this list of conditions and the following disclaimer in the
+* documentation and/or other materials provided with the distribution.
+*
+* Neither the name of the project's author nor the names of its
+* contributors may be used to endorse or promote products derived from
+* this software without specific prior written permission.
+*
+* THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+* "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+* LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+* FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+* HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+* SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED
+* TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+* PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+* LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+* NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+* SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*
+*/
+
+
+#include "framedecoder.h"
+#include "packagefiscal.h"
+
+FrameDecoder::FrameDecoder()
+    : m_state(Idle)
+    , m_sequence(0)
+    , m_busy(0)
+    , m_sum(0)
+    , m_checksumCount(0)
+{
+    // keeps the capacity across resize(0), frames are decoded in place
+    m_frame.reserve(512);
+}
+
+void FrameDecoder::reset()
+{
+    m_state = Idle;
+    m_frame.resize(0);
+    m_sum = 0;
+    m_checksumCount = 0;
+}
+
+void FrameDecoder::begin()
+{
+    m_frame.resize(0);
+    m_frame += static_cast<char>(PackageFiscal::STX);
+    m_sum = PackageFiscal::STX;
+    m_checksumCount = 0;
+    m_state = Sequence;
+}
+
+int FrameDecoder::feed(const char *data, int size, Event *event)
+{
+    *event = None;
+
+    int i = 0;
+    while (i < size) {
+        switch (m_state) {
+        case Idle: {
+            const char c = data[i++];
+            if (c == PackageFiscal::STX) {
+                begin();
+            } else if (c == PackageFiscal::NAK) {
+                *event = Nak;
+                return i;
+            } else if (c >= PackageFiscal::DC1 && c <= PackageFiscal::DC4) {
+                m_busy = c;
+                *event = Busy;
+                return i;
+            }
+            // FNU, ACK and noise between frames are dropped
+            break;
+        }
+        case Sequence: {
+            const char c = data[i++];
+            if (c == PackageFiscal::STX) {
+                begin();
+                break;
+            }
+            m_sequence = static_cast<uchar>(c);
+            m_frame += c;
+            m_sum += m_sequence;
+            m_state = Body;
+            break;
+        }
+        case Body: {
+            // take the whole run up to the next control byte in one append
+            const int start = i;
+            while (i < size && data[i] != PackageFiscal::ETX && data[i] != PackageFiscal::STX
+                    && data[i] != PackageFiscal::ESC) {
+                m_sum += static_cast<uchar>(data[i]);
+                i++;
+            }
+            m_frame.append(data + start, i - start);
+
+            if (i == size)
+                break;
+
+            const char c = data[i++];
+            if (c == PackageFiscal::STX) {
+                // dropped, as the drivers always did
+                break;
+            }
+
+            m_sum += static_cast<uchar>(c);
+            if (c == PackageFiscal::ESC) {
+                m_state = Escape;
+                break;
+            }
+
+            m_frame += c;
+            m_state = Checksum;
+            break;
+        }
+        case Escape: {
+            // STX, ETX, ESC or FS as data
+            const char c = data[i++];
+            m_sum += static_cast<uchar>(c);
+            m_frame += c;
+            m_state = Body;
+            break;
+        }
+        case Checksum:
+            m_frame += data[i++];
+            if (++m_checksumCount == 4) {
+                m_state = Idle;
+                *event = (m_sequence == PackageFiscal::CUE) ? Intermediate : Frame;
+                return i;
+            }
+            break;
+        }
+    }
+
+    return i;
+}
+
+const QByteArray &FrameDecoder::frame() const
+{
+    return m_frame;
+}
+
+uchar FrameDecoder::sequence() const
+{
+    return m_sequence;
+}
+
+char FrameDecoder::busy() const
+{
+    return m_busy;
+}
+
+bool FrameDecoder::checksumOk() const
+{
+    if (m_checksumCount != 4)
+        return false;
+
+    uint checksum = 0;
+    const char *p = m_frame.constData() + m_frame.size() - 4;
+    for (int i = 0; i < 4; i++) {
+        const char c = p[i];
+        checksum <<= 4;
+        if (c >= '0' && c <= '9')
+            checksum |= c - '0';
+        else if (c >= 'A' && c <= 'F')
+            checksum |= c - 'A' + 10;
+        else if (c >= 'a' && c <= 'f')
+            checksum |= c - 'a' + 10;
+        else
+            return false;
+    }
+
+    return checksum == (m_sum & 0xffff);
+}
@@ -0,0 +1,89 @@
+/*
+*
+* Copyright (C)2018, Samuel Isuani <sisuani@gmail.com>
+* All rights reserved.
+*
+* Redistribution and use in source and binary forms, with or without
+* modification, are permitted provided that the following conditions
+* are met:
+*
+* Redistributions of source code must retain the above copyright notice,
+* this list of conditions and the following disclaimer.
+*
+* Redistributions in binary form must reproduce the above copyright
+* notice, this list of conditions and the following disclaimer in the
+* documentation and/or other materials provided with the distribution.
+*
+* Neither the name of the project's author nor the names of its
+* contributors may be used to endorse or promote products derived from
+* this software without specific prior written permission.
+*
+* THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+* "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+* LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+* FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+* HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+* SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED
+* TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+* PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+* LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+* NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+* SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*
+*/
+
+
+#ifndef FRAMEDECODER_H
+#define FRAMEDECODER_H
+
+#include <QByteArray>
+
+// Incremental decoder for the STX ... ETX + 4 hex checksum framing shared by
+// the serial printers. It does no I/O: feed() takes any chunk of bytes and
+// stops at the first event, so it can be driven from recorded traces too.
+// ESC escapes the byte after it, frame() holds the body unescaped while the
+// checksum is summed over the bytes as they came. A stray STX inside a body
+// is dropped, the frame goes on.
+class FrameDecoder
+{
+
+public:
+    enum Event {
+        None = 0,
+        Frame,          // frame() holds a complete reply
+        Nak,
+        Busy,           // DC1..DC4, the printer is still working
+        Intermediate    // 0x80 keepalive frame, already discarded
+    };
+
+    FrameDecoder();
+
+    void reset();
+    int feed(const char *data, int size, Event *event);
+
+    // valid until the next feed() call
+    const QByteArray &frame() const;
+    uchar sequence() const;
+    char busy() const;
+    bool checksumOk() const;
+
+private:
+    enum State {
+        Idle = 0,
+        Sequence,
+        Body,
+        Escape,
+        Checksum
+    };
+
+    void begin();
+
+    State m_state;
+    QByteArray m_frame;
+    uchar m_sequence;
+    char m_busy;
+    uint m_sum;
+    int m_checksumCount;
+};
+
+#endif // FRAMEDECODER_H
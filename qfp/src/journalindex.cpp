@@ -0,0 +1,186 @@
+/*
+*
+* Copyright (C)2018, Samuel Isuani <sisuani@gmail.com>
+* All rights reserved.
+*
+* Redistribution and use in source and binary forms, with or without
+* modification, are permitted provided that the following conditions
+* are met:
+*
+* Redistributions of source code must retain the above copyright notice,
+* this list of conditions and the following disclaimer.
+*
+* Redistributions in binary form must reproduce the above copyright
+* notice, this list of conditions and the following disclaimer in the
+* documentation and/or other materials provided with the distribution.
+*
+* Neither the name of the project's author nor the names of its
+* contributors may be used to endorse or promote products derived from
+* this software without specific prior written permission.
+*
+* THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+* "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+* LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+* FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+* HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+* SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED
+* TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+* PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+* LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+* NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+* SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*
+*/
+
+
+#include "journalindex.h"
+#include "logger.h"
+
+#include <QFileInfo>
+#include <QMutexLocker>
+#include <QStringList>
+
+#if defined (Q_OS_UNIX)
+#include <unistd.h>
+#elif defined (Q_OS_WIN32)
+#include <io.h>
+#endif
+
+static QString reportKey(const QString &type, const QDate &day)
+{
+    return type + ' ' + day.toString("yyyyMMdd");
+}
+
+static QString documentKey(const int docType, const int number)
+{
+    return QString("%1 %2").arg(docType).arg(number);
+}
+
+JournalIndex::JournalIndex(const QString &path, QObject *parent)
+    : QObject(parent)
+    , m_file(path)
+    , m_dir(QFileInfo(path).absolutePath())
+{
+    if (!m_file.open(QIODevice::ReadWrite | QIODevice::Append))
+        return;
+
+    // "R type yyyyMMdd bytes hash file" and "D doctype number yyyyMMdd",
+    // a line cut short by a crash ends the file and is cut off so the
+    // next record starts clean
+    qint64 end = 0;
+    m_file.seek(0);
+    while (!m_file.atEnd()) {
+        const QString line = QString(m_file.readLine());
+        if (!line.endsWith("\n"))
+            break;
+        end = m_file.pos();
+
+        const QStringList f = line.trimmed().split(' ');
+        if (f.at(0) == "R" && f.size() >= 6) {
+            m_reports.insert(reportKey(f.at(1), QDate::fromString(f.at(2), "yyyyMMdd")),
+                    qMakePair(QStringList(f.mid(5)).join(" "), f.at(3).toLongLong()));
+        } else if (f.at(0) == "D" && f.size() == 4) {
+            m_documents.insert(documentKey(f.at(1).toInt(), f.at(2).toInt()),
+                    QDate::fromString(f.at(3), "yyyyMMdd"));
+        }
+    }
+    if (end < m_file.size()) {
+#ifdef DEBUG
+        log << QString("JournalIndex() -> dropping %1 bytes of a torn line").arg(m_file.size() - end);
+#endif
+        if (!m_file.resize(end)) {
+            m_file.close();
+            return;
+        }
+        sync();
+    }
+
+#ifdef DEBUG
+    log << QString("JournalIndex() -> %1 reports %2 documents in %3")
+        .arg(m_reports.size()).arg(m_documents.size()).arg(path);
+#endif
+}
+
+bool JournalIndex::isOpen() const
+{
+    return m_file.isOpen();
+}
+
+bool JournalIndex::addReport(const QString &type, const QDate &day, const QString &file,
+        const qint64 bytes, const QByteArray &hash)
+{
+    const QString name = m_dir.relativeFilePath(file);
+
+    QMutexLocker locker(&m_mutex);
+    if (!append(QString("R %1 %2 %3 %4 %5\n").arg(type).arg(day.toString("yyyyMMdd"))
+                .arg(bytes).arg(hash.toHex().constData()).arg(name)))
+        return false;
+    m_reports.insert(reportKey(type, day), qMakePair(name, bytes));
+    return true;
+}
+
+QString JournalIndex::report(const QString &type, const QDate &day) const
+{
+    QMutexLocker locker(&m_mutex);
+    const QHash<QString, QPair<QString, qint64> >::const_iterator it = m_reports.find(reportKey(type, day));
+    if (it == m_reports.end())
+        return QString();
+
+    // removed or truncated behind our back
+    const QFileInfo info(m_dir.absoluteFilePath(it.value().first));
+    if (!info.exists() || info.size() != it.value().second)
+        return QString();
+    return info.absoluteFilePath();
+}
+
+QDate JournalIndex::documentDate(const int docType, const int number) const
+{
+    QMutexLocker locker(&m_mutex);
+    return m_documents.value(documentKey(docType, number));
+}
+
+QString JournalIndex::document(const QString &type, const int docType, const int number) const
+{
+    const QDate day = documentDate(docType, number);
+    if (day.isNull())
+        return QString();
+    return report(type, day);
+}
+
+void JournalIndex::record(int id, int number, int type)
+{
+    Q_UNUSED(id);
+
+    // the day of the computer, the printer closes it with its own clock
+    const QDate day = QDate::currentDate();
+
+    QMutexLocker locker(&m_mutex);
+    if (append(QString("D %1 %2 %3\n").arg(type).arg(number).arg(day.toString("yyyyMMdd"))))
+        m_documents.insert(documentKey(type, number), day);
+}
+
+bool JournalIndex::append(const QString &line)
+{
+    const QByteArray data = line.toLatin1();
+    const qint64 end = m_file.size();
+    if (m_file.write(data) != data.size() || !m_file.flush()) {
+        // a short write would glue the next line to it
+        m_file.resize(end);
+#ifdef DEBUG
+        log << QString("JournalIndex::append() -> not written: %1").arg(m_file.errorString());
+#endif
+        return false;
+    }
+    sync();
+    return true;
+}
+
+void JournalIndex::sync()
+{
+    m_file.flush();
+#if defined (Q_OS_UNIX)
+    fsync(m_file.handle());
+#elif defined (Q_OS_WIN32)
+    _commit(m_file.handle());
+#endif
+}
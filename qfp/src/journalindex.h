@@ -0,0 +1,82 @@
+/*
+*
+* Copyright (C)2018, Samuel Isuani <sisuani@gmail.com>
+* All rights reserved.
+*
+* Redistribution and use in source and binary forms, with or without
+* modification, are permitted provided that the following conditions
+* are met:
+*
+* Redistributions of source code must retain the above copyright notice,
+* this list of conditions and the following disclaimer.
+*
+* Redistributions in binary form must reproduce the above copyright
+* notice, this list of conditions and the following disclaimer in the
+* documentation and/or other materials provided with the distribution.
+*
+* Neither the name of the project's author nor the names of its
+* contributors may be used to endorse or promote products derived from
+* this software without specific prior written permission.
+*
+* THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+* "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+* LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+* FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+* HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+* SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED
+* TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+* PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+* LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+* NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+* SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*
+*/
+
+
+#ifndef JOURNALINDEX_H
+#define JOURNALINDEX_H
+
+#include <QObject>
+#include <QDate>
+#include <QDir>
+#include <QFile>
+#include <QHash>
+#include <QMutex>
+
+// Local index of the electronic journal: the downloaded report of each
+// type and day, and the day every document was printed on. Lookups are
+// answered from disk, only what is missing has to come from the printer.
+// Kept in an append-only file, report files are stored next to it.
+class JournalIndex : public QObject
+{
+    Q_OBJECT
+
+public:
+    explicit JournalIndex(const QString &path, QObject *parent = 0);
+
+    bool isOpen() const;
+
+    bool addReport(const QString &type, const QDate &day, const QString &file,
+            const qint64 bytes, const QByteArray &hash);
+    // path of the report, empty if missing or not of the size indexed
+    QString report(const QString &type, const QDate &day) const;
+    QDate documentDate(const int docType, const int number) const;
+    // the report of the day the document is in
+    QString document(const QString &type, const int docType, const int number) const;
+
+public slots:
+    // connected to fiscalReceiptNumber like ReceiptLedger::record
+    void record(int id, int number, int type);
+
+private:
+    bool append(const QString &line);
+    void sync();
+
+    QFile m_file;
+    QDir m_dir;
+    mutable QMutex m_mutex;
+    QHash<QString, QPair<QString, qint64> > m_reports;
+    QHash<QString, QDate> m_documents;
+};
+
+#endif // JOURNALINDEX_H
@@ -0,0 +1,109 @@
+/*
+*
+* Copyright (C)2018, Samuel Isuani <sisuani@gmail.com>
+* All rights reserved.
+*
+* Redistribution and use in source and binary forms, with or without
+* modification, are permitted provided that the following conditions
+* are met:
+*
+* Redistributions of source code must retain the above copyright notice,
+* this list of conditions and the following disclaimer.
+*
+* Redistributions in binary form must reproduce the above copyright
+* notice, this list of conditions and the following disclaimer in the
+* documentation and/or other materials provided with the distribution.
+*
+* Neither the name of the project's author nor the names of its
+* contributors may be used to endorse or promote products derived from
+* this software without specific prior written permission.
+*
+* THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+* "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+* LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+* FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+* HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+* SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED
+* TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+* PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+* LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+* NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+* SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*
+*/
+
+
+#include "jsontemplate.h"
+
+static const char HEX[] = "0123456789abcdef";
+
+JsonTemplate::JsonTemplate(const char *json)
+    : m_size(0)
+{
+    const QByteArray t(json);
+    int from = 0;
+    for (int i = 0; i < t.size(); i++) {
+        if (t.at(i) != '$')
+            continue;
+        m_parts.append(t.mid(from, i - from));
+        from = i + 1;
+    }
+    m_parts.append(t.mid(from));
+    m_size = t.size() - slotCount();
+}
+
+int JsonTemplate::slotCount() const
+{
+    return m_parts.size() - 1;
+}
+
+QByteArray JsonTemplate::render(const QString *values) const
+{
+    const int count = slotCount();
+
+    // quotes and a little escaping room, so it is not grown on the way
+    int size = m_size;
+    for (int i = 0; i < count; i++)
+        size += values[i].size() + 8;
+
+    QByteArray out;
+    out.reserve(size);
+    for (int i = 0; i < count; i++) {
+        out.append(m_parts.at(i));
+        appendString(&out, values[i]);
+    }
+    out.append(m_parts.at(count));
+    return out;
+}
+
+void JsonTemplate::appendString(QByteArray *out, const QString &value)
+{
+    // as QJson::Serializer's sanitizeString(): it stops at a NUL and
+    // passes control characters other than these through as they are
+    out->append('"');
+    const QChar *c = value.unicode();
+    for (int i = 0; i < value.size() && c[i].unicode(); i++) {
+        const ushort u = c[i].unicode();
+        switch (u) {
+            case '"':  out->append("\\\""); break;
+            case '\\': out->append("\\\\"); break;
+            case '\b': out->append("\\b"); break;
+            case '\f': out->append("\\f"); break;
+            case '\n': out->append("\\n"); break;
+            case '\r': out->append("\\r"); break;
+            case '\t': out->append("\\t"); break;
+            default:
+                if (u < 0x80) {
+                    out->append(char(u));
+                } else {
+                    out->append("\\u");
+                    out->append(HEX[(u >> 12) & 0xf]);
+                    out->append(HEX[(u >> 8) & 0xf]);
+                    out->append(HEX[(u >> 4) & 0xf]);
+                    out->append(HEX[u & 0xf]);
+                }
+                break;
+        }
+    }
+    out->append('"');
+}
@@ -0,0 +1,69 @@
+/*
+*
+* Copyright (C)2018, Samuel Isuani <sisuani@gmail.com>
+* All rights reserved.
+*
+* Redistribution and use in source and binary forms, with or without
+* modification, are permitted provided that the following conditions
+* are met:
+*
+* Redistributions of source code must retain the above copyright notice,
+* this list of conditions and the following disclaimer.
+*
+* Redistributions in binary form must reproduce the above copyright
+* notice, this list of conditions and the following disclaimer in the
+* documentation and/or other materials provided with the distribution.
+*
+* Neither the name of the project's author nor the names of its
+* contributors may be used to endorse or promote products derived from
+* this software without specific prior written permission.
+*
+* THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+* "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+* LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+* FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+* HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+* SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED
+* TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+* PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+* LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+* NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+* SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*
+*/
+
+
+#ifndef JSONTEMPLATE_H
+#define JSONTEMPLATE_H
+
+#include <QByteArray>
+#include <QList>
+#include <QString>
+
+// JSON body compiled once, with a $ wherever a string value goes:
+//
+//     static const JsonTemplate PAY("{ \"ImprimirPago\" : { \"Monto\" : $ } }");
+//     const QString v[] = { "10.00" };
+//     const QByteArray json = PAY.render(v);
+//
+// render() only escapes the values and copies them between the constant
+// parts, into a buffer allocated once at its final size. Strings are
+// escaped the way QJson::Serializer does it, so a template laid out as its
+// IndentNone output renders the same bytes.
+class JsonTemplate
+{
+
+public:
+    explicit JsonTemplate(const char *json);
+
+    int slotCount() const;
+    QByteArray render(const QString *values) const; // slotCount() of them
+
+private:
+    static void appendString(QByteArray *out, const QString &value);
+
+    QList<QByteArray> m_parts; // slotCount() + 1
+    int m_size;
+};
+
+#endif // JSONTEMPLATE_H
@@ -36,7 +36,6 @@
 
 #include <QNetworkRequest>
 #include <QNetworkReply>
-#include <QEventLoop>
 #include <QJson/Parser>
 #include <QJson/Serializer>
 #include <QTimer>
@@ -44,9 +43,15 @@
 #include "logger.h"
 
 NetworkPort::NetworkPort(QObject *parent, const QString &host, const int port)
-    : QThread(0)
+    : QObject(parent)
+    , m_reply(0)
+    , m_lastError(NP_NO_ERROR)
 {
     networkManager = new QNetworkAccessManager(this);
+    m_timer = new QTimer(this);
+    m_timer->setSingleShot(true);
+    m_timer->setInterval(10 * 1000);
+    connect(m_timer, SIGNAL(timeout()), this, SLOT(timeout()));
     url.setUrl(host);
     url.setPort(port);
 }
@@ -66,26 +71,44 @@ const int NetworkPort::lastError() const
 }
 
 void NetworkPort::post(const QVariantMap &body)
+{
+    QJson::Serializer serializer;
+    postJson(serializer.serialize(body));
+}
+
+void NetworkPort::postJson(const QByteArray &json)
 {
     QNetworkRequest request(url);
     request.setRawHeader("Content-type", "application/json");
 
-    QJson::Serializer serializer;
-    log << serializer.serialize(body);
-    QNetworkReply *reply = networkManager->post(request, serializer.serialize(body));
+    log << json;
+    m_reply = networkManager->post(request, json);
     m_lastError = NP_NO_ERROR;
 
-    QTimer timer;
-    QEventLoop loop;
-    connect(reply, SIGNAL(finished()), &loop, SLOT(quit()));
-    QTimer::connect(&timer, SIGNAL(timeout()), &loop, SLOT(quit()));
-    timer.start(10 * 1000);
-    loop.exec();
+    connect(m_reply, SIGNAL(finished()), this, SLOT(replyFinished()));
+    m_timer->start();
+}
+
+void NetworkPort::timeout()
+{
+    // finished() follows with no status code
+    if (m_reply)
+        m_reply->abort();
+}
+
+void NetworkPort::replyFinished()
+{
+    QNetworkReply *reply = qobject_cast<QNetworkReply *>(sender());
+    if (!reply || reply != m_reply)
+        return;
+
+    m_timer->stop();
+    m_reply = 0;
+    reply->deleteLater();
 
     const int statusCode = reply->attribute(QNetworkRequest::HttpStatusCodeAttribute).toInt();
     if (statusCode == 200) {
         QByteArray json = reply->readAll();
-        reply->deleteLater();
 
         QJson::Parser parser;
         bool parseOk = true;
@@ -35,12 +35,17 @@
 #ifndef NETWORKPORT_H
 #define NETWORKPORT_H
 
-#include <QThread>
+#include <QObject>
 #include <QVariantMap>
 #include <QUrl>
 #include <QtNetwork/QNetworkAccessManager>
 
-class NetworkPort : public QThread
+class QNetworkReply;
+class QTimer;
+
+// Asynchronous: post() returns at once, finished() tells the reply is in.
+// Lives in the thread of its Connector, which may serve many ports.
+class NetworkPort : public QObject
 {
     Q_OBJECT
 
@@ -64,9 +69,16 @@ signals:
 
 public slots:
     void post(const QVariantMap &body);
+    void postJson(const QByteArray &json); // body already serialized
+
+private slots:
+    void replyFinished();
+    void timeout();
 
 private:
     QNetworkAccessManager *networkManager;
+    QNetworkReply *m_reply;
+    QTimer *m_timer;
     QUrl url;
     QVariantMap m_lastReply;
     int m_lastError;
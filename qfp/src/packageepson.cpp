@@ -39,8 +39,12 @@ PackageEpson::PackageEpson(QObject *parent)
     : QObject(parent)
 {
     m_id = 0;
-    m_last_secuence = m_secuence;
-    nextSecuence();
+    m_last_secuence = 0x20;
+}
+
+void PackageEpson::setSecuence(const int secuence)
+{
+    m_last_secuence = secuence;
 }
 
 void PackageEpson::setId(int id)
@@ -54,10 +54,9 @@ public:
     QByteArray &fiscalPackage();
     int checksum();
 
-    static int m_secuence;
+    void setSecuence(const int secuence); // assigned by the driver when sent
 
 private:
-    void nextSecuence() { if(++m_secuence >= 0x7f) m_secuence = 0x20; }
     int m_id;
     int m_cmd;
     int m_last_secuence;
@@ -40,8 +40,12 @@ PackageEpsonExt::PackageEpsonExt(QObject *parent)
     : QObject(parent)
 {
     m_id = 0;
-    m_last_secuence = m_secuence;
-    nextSecuence();
+    m_last_secuence = 0x81;
+}
+
+void PackageEpsonExt::setSecuence(const int secuence)
+{
+    m_last_secuence = secuence;
 }
 
 void PackageEpsonExt::setId(int id)
@@ -64,6 +68,11 @@ int PackageEpsonExt::cmd()
     return m_cmd;
 }
 
+int PackageEpsonExt::secuence()
+{
+    return m_last_secuence;
+}
+
 void PackageEpsonExt::setData(const QByteArray &data)
 {
     m_data = data;
@@ -48,15 +48,15 @@ public:
     int id();
     void setCmd(const int cmd);
     int cmd();
+    int secuence();
     void setData(const QByteArray &data);
     QByteArray &data();
     QByteArray &fiscalPackage();
     int checksum();
 
-    static int m_secuence;
+    void setSecuence(const int secuence); // assigned by the driver when sent
 
 private:
-    void nextSecuence() { if(++m_secuence >= 0xff) m_secuence = 0x81; }
     int m_id;
     int m_cmd;
     int m_last_secuence;
@@ -48,6 +48,7 @@ public:
         DC3 = 0x13,
         DC4 = 0x14,
         NAK = 0x15,
+        ESC = 0x1b,
         FS  = 0x1c,
         CUE = 0x80
     };
@@ -42,8 +42,12 @@ PackageHasar::PackageHasar(QObject *parent)
 {
     m_id = 0;
     m_ftype = 0;
-    m_last_secuence = m_secuence;
-    nextSecuence();
+    m_last_secuence = 0x20;
+}
+
+void PackageHasar::setSecuence(const int secuence)
+{
+    m_last_secuence = secuence;
 }
 
 void PackageHasar::setCmd(int cmd)
@@ -55,10 +55,9 @@ public:
     QByteArray &fiscalPackage();
     int checksum();
 
-    static int m_secuence;
+    void setSecuence(const int secuence); // assigned by the driver when sent
 
 private:
-    void nextSecuence() { if(++m_secuence >= 0x7f) m_secuence = 0x20; }
     int m_cmd;
     int m_ftype;
     int m_id;
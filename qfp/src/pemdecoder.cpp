@@ -0,0 +1,151 @@
+/*
+*
+* Copyright (C)2018, Samuel Isuani <sisuani@gmail.com>
+* All rights reserved.
+*
+* Redistribution and use in source and binary forms, with or without
+* modification, are permitted provided that the following conditions
+* are met:
+*
+* Redistributions of source code must retain the above copyright notice,
+* this list of conditions and the following disclaimer.
+*
+* Redistributions in binary form must reproduce the above copyright
+* notice, this list of conditions and the following disclaimer in the
+* documentation and/or other materials provided with the distribution.
+*
+* Neither the name of the project's author nor the names of its
+* contributors may be used to endorse or promote products derived from
+* this software without specific prior written permission.
+*
+* THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+* "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+* LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+* FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+* HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+* SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED
+* TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+* PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+* LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+* NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+* SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*
+*/
+
+
+#include "pemdecoder.h"
+#include "logger.h"
+
+static int base64Value(const char c)
+{
+    if (c >= 'A' && c <= 'Z')
+        return c - 'A';
+    if (c >= 'a' && c <= 'z')
+        return c - 'a' + 26;
+    if (c >= '0' && c <= '9')
+        return c - '0' + 52;
+    if (c == '+')
+        return 62;
+    if (c == '/')
+        return 63;
+    return -1;
+}
+
+PemDecoder::PemDecoder(QIODevice *out, QObject *parent)
+    : QIODevice(parent)
+    , m_out(out)
+#if (QT_VERSION >= QT_VERSION_CHECK(5, 0, 0))
+    , m_hash(QCryptographicHash::Sha256)
+#else
+    , m_hash(QCryptographicHash::Sha1)
+#endif
+    , m_state(Header)
+    , m_quadSize(0)
+    , m_decoded(0)
+{
+}
+
+bool PemDecoder::isSequential() const
+{
+    return true;
+}
+
+bool PemDecoder::isFinished() const
+{
+    return m_state == Trailer;
+}
+
+qint64 PemDecoder::decoded() const
+{
+    return m_decoded;
+}
+
+QByteArray PemDecoder::hash() const
+{
+    return m_hash.result();
+}
+
+qint64 PemDecoder::readData(char *data, qint64 maxSize)
+{
+    Q_UNUSED(data);
+    Q_UNUSED(maxSize);
+    return -1;
+}
+
+qint64 PemDecoder::writeData(const char *data, qint64 size)
+{
+    // at most 3 bytes out for every 4 in
+    QByteArray out;
+    out.reserve(int(size / 4 * 3 + 3));
+
+    for (qint64 i = 0; i < size; i++) {
+        const char c = data[i];
+
+        if (m_state == Header) {
+            if (c != '\n') {
+                // only the start of the line matters
+                if (m_line.size() < 16)
+                    m_line.append(c);
+                continue;
+            }
+            if (m_line.startsWith("-----BEGIN"))
+                m_state = Body;
+            m_line.clear();
+        } else if (m_state == Body) {
+            // base64 has no '-', it can only be the END line
+            if (c == '-') {
+                m_state = Trailer;
+                continue;
+            }
+
+            const int v = base64Value(c);
+            if (v < 0 && c != '=')
+                continue; // line breaks and framing left overs
+
+            m_quad[m_quadSize++] = v;
+            if (m_quadSize < 4)
+                continue;
+
+            m_quadSize = 0;
+            out.append(char(m_quad[0] << 2 | m_quad[1] >> 4));
+            if (m_quad[2] >= 0)
+                out.append(char(m_quad[1] << 4 | m_quad[2] >> 2));
+            if (m_quad[2] >= 0 && m_quad[3] >= 0)
+                out.append(char(m_quad[2] << 6 | m_quad[3]));
+        }
+    }
+
+    if (!out.isEmpty()) {
+        if (m_out->write(out) != out.size()) {
+#ifdef DEBUG
+            log << QString("PemDecoder::writeData() -> write failed at %1").arg(m_decoded);
+#endif
+            setErrorString(m_out->errorString());
+            return -1;
+        }
+        m_hash.addData(out);
+        m_decoded += out.size();
+    }
+
+    return size;
+}
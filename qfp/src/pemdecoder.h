@@ -0,0 +1,78 @@
+/*
+*
+* Copyright (C)2018, Samuel Isuani <sisuani@gmail.com>
+* All rights reserved.
+*
+* Redistribution and use in source and binary forms, with or without
+* modification, are permitted provided that the following conditions
+* are met:
+*
+* Redistributions of source code must retain the above copyright notice,
+* this list of conditions and the following disclaimer.
+*
+* Redistributions in binary form must reproduce the above copyright
+* notice, this list of conditions and the following disclaimer in the
+* documentation and/or other materials provided with the distribution.
+*
+* Neither the name of the project's author nor the names of its
+* contributors may be used to endorse or promote products derived from
+* this software without specific prior written permission.
+*
+* THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+* "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+* LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+* FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+* HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+* SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED
+* TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+* PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+* LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+* NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+* SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*
+*/
+
+
+#ifndef PEMDECODER_H
+#define PEMDECODER_H
+
+#include <QIODevice>
+#include <QCryptographicHash>
+
+// Write-only device that takes a PEM report as it comes from the printer,
+// in chunks of any size, and writes the DER body to another device while
+// hashing it. Nothing is kept but a partial base64 quad, so it can be the
+// sink of FiscalPrinter::downloadReportByNumber() for any report size.
+class PemDecoder : public QIODevice
+{
+    Q_OBJECT
+
+public:
+    explicit PemDecoder(QIODevice *out, QObject *parent = 0);
+
+    bool isSequential() const;
+    bool isFinished() const;    // the END line came in
+    qint64 decoded() const;     // bytes written to out
+    QByteArray hash() const;    // of those bytes, SHA-256 (SHA-1 on Qt 4)
+
+protected:
+    qint64 readData(char *data, qint64 maxSize);
+    qint64 writeData(const char *data, qint64 size);
+
+private:
+    enum State {
+        Header,     // up to the BEGIN line
+        Body,
+        Trailer     // from the END line on, ignored
+    };
+
+    QIODevice *m_out;
+    QCryptographicHash m_hash;
+    State m_state;
+    QByteArray m_line;
+    int m_quad[4];
+    int m_quadSize;
+    qint64 m_decoded;
+};
+
+#endif // PEMDECODER_H
@@ -0,0 +1,130 @@
+/*
+*
+* Copyright (C)2018, Samuel Isuani <sisuani@gmail.com>
+* All rights reserved.
+*
+* Redistribution and use in source and binary forms, with or without
+* modification, are permitted provided that the following conditions
+* are met:
+*
+* Redistributions of source code must retain the above copyright notice,
+* this list of conditions and the following disclaimer.
+*
+* Redistributions in binary form must reproduce the above copyright
+* notice, this list of conditions and the following disclaimer in the
+* documentation and/or other materials provided with the distribution.
+*
+* Neither the name of the project's author nor the names of its
+* contributors may be used to endorse or promote products derived from
+* this software without specific prior written permission.
+*
+* THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+* "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+* LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+* FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+* HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+* SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED
+* TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+* PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+* LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+* NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+* SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*
+*/
+
+
+#include "receiptledger.h"
+#include "logger.h"
+
+#include <QMutexLocker>
+#include <QStringList>
+
+#if defined (Q_OS_UNIX)
+#include <unistd.h>
+#elif defined (Q_OS_WIN32)
+#include <io.h>
+#endif
+
+ReceiptLedger::ReceiptLedger(const QString &path, QObject *parent)
+    : QObject(parent)
+    , m_file(path)
+{
+    if (!m_file.open(QIODevice::ReadWrite | QIODevice::Append))
+        return;
+
+    // one "id number type" line per document, a line cut short by a crash
+    // ends the file and is cut off so the next one starts clean
+    qint64 end = 0;
+    m_file.seek(0);
+    while (!m_file.atEnd()) {
+        const QStringList f = QString(m_file.readLine()).split(' ');
+        if (f.size() < 3 || !f.at(2).endsWith("\n"))
+            break;
+        m_numbers.insert(f.at(0).toInt(), f.at(1).toInt());
+        end = m_file.pos();
+    }
+    if (end < m_file.size()) {
+#ifdef DEBUG
+        log << QString("ReceiptLedger() -> dropping %1 bytes of a torn line").arg(m_file.size() - end);
+#endif
+        if (!m_file.resize(end)) {
+            m_file.close();
+            return;
+        }
+        sync();
+    }
+
+#ifdef DEBUG
+    log << QString("ReceiptLedger() -> %1 receipts in %2").arg(m_numbers.size()).arg(path);
+#endif
+}
+
+bool ReceiptLedger::isOpen() const
+{
+    return m_file.isOpen();
+}
+
+bool ReceiptLedger::contains(const int id) const
+{
+    QMutexLocker locker(&m_mutex);
+    return m_numbers.contains(id);
+}
+
+int ReceiptLedger::number(const int id) const
+{
+    QMutexLocker locker(&m_mutex);
+    return m_numbers.value(id, -1);
+}
+
+void ReceiptLedger::record(int id, int number, int type)
+{
+    // the drivers use -1 for documents nobody asked for
+    if (id < 0)
+        return;
+
+    QMutexLocker locker(&m_mutex);
+    m_numbers.insert(id, number);
+
+    const QByteArray line = QString("%1 %2 %3\n").arg(id).arg(number).arg(type).toLatin1();
+    const qint64 end = m_file.size();
+    if (m_file.write(line) != line.size() || !m_file.flush()) {
+        // a short write would glue the next line to it; kept in memory,
+        // only a restart forgets it
+        m_file.resize(end);
+#ifdef DEBUG
+        log << QString("ReceiptLedger::record() -> %1 not written: %2").arg(id).arg(m_file.errorString());
+#endif
+        return;
+    }
+    sync();
+}
+
+void ReceiptLedger::sync()
+{
+    m_file.flush();
+#if defined (Q_OS_UNIX)
+    fsync(m_file.handle());
+#elif defined (Q_OS_WIN32)
+    _commit(m_file.handle());
+#endif
+}
@@ -0,0 +1,70 @@
+/*
+*
+* Copyright (C)2018, Samuel Isuani <sisuani@gmail.com>
+* All rights reserved.
+*
+* Redistribution and use in source and binary forms, with or without
+* modification, are permitted provided that the following conditions
+* are met:
+*
+* Redistributions of source code must retain the above copyright notice,
+* this list of conditions and the following disclaimer.
+*
+* Redistributions in binary form must reproduce the above copyright
+* notice, this list of conditions and the following disclaimer in the
+* documentation and/or other materials provided with the distribution.
+*
+* Neither the name of the project's author nor the names of its
+* contributors may be used to endorse or promote products derived from
+* this software without specific prior written permission.
+*
+* THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+* "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+* LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+* FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+* HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+* SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED
+* TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+* PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+* LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+* NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+* SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*
+*/
+
+
+#ifndef RECEIPTLEDGER_H
+#define RECEIPTLEDGER_H
+
+#include <QObject>
+#include <QFile>
+#include <QHash>
+#include <QMutex>
+
+// Caller receipt id -> fiscal number of every document the printer closed,
+// kept in an append-only file so it survives restarts. FiscalPrinter uses
+// it to tell a retried submission from a new one.
+class ReceiptLedger : public QObject
+{
+    Q_OBJECT
+
+public:
+    explicit ReceiptLedger(const QString &path, QObject *parent = 0);
+
+    bool isOpen() const;
+    bool contains(const int id) const;
+    int number(const int id) const; // -1 if id was never printed
+
+public slots:
+    // connected straight to the driver, so it is on disk before the reply finishes
+    void record(int id, int number, int type);
+
+private:
+    void sync();
+
+    QFile m_file;
+    mutable QMutex m_mutex;
+    QHash<int, int> m_numbers;
+};
+
+#endif // RECEIPTLEDGER_H
@@ -0,0 +1,169 @@
+/*
+*
+* Copyright (C)2018, Samuel Isuani <sisuani@gmail.com>
+* All rights reserved.
+*
+* Redistribution and use in source and binary forms, with or without
+* modification, are permitted provided that the following conditions
+* are met:
+*
+* Redistributions of source code must retain the above copyright notice,
+* this list of conditions and the following disclaimer.
+*
+* Redistributions in binary form must reproduce the above copyright
+* notice, this list of conditions and the following disclaimer in the
+* documentation and/or other materials provided with the distribution.
+*
+* Neither the name of the project's author nor the names of its
+* contributors may be used to endorse or promote products derived from
+* this software without specific prior written permission.
+*
+* THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+* "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+* LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+* FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+* HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+* SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED
+* TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+* PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+* LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+* NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+* SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*
+*/
+
+
+#include "replyview.h"
+#include "packagefiscal.h"
+
+#include <limits.h>
+
+static inline bool isBlank(const char c)
+{
+    return c == ' ' || (c >= '\t' && c <= '\r');
+}
+
+ReplyView::ReplyView(const QByteArray &frame)
+    : m_frame(frame)
+    , m_end(frame.size())
+{
+    const char *d = m_frame.constData();
+
+    if(m_end >= 5 && d[m_end - 5] == PackageFiscal::ETX)
+        m_end -= 5;
+
+    // field 0 starts right after the STX
+    m_fs.append(0);
+    for(int i = 1; i < m_end; i++) {
+        if(d[i] == PackageFiscal::FS)
+            m_fs.append(i);
+    }
+}
+
+int ReplyView::size() const
+{
+    return m_frame.size();
+}
+
+int ReplyView::fieldCount() const
+{
+    return m_end > 0 ? m_fs.size() : 0;
+}
+
+QByteArray ReplyView::field(const int i) const
+{
+    if(i < 0 || i >= fieldCount())
+        return QByteArray();
+
+    const int from = m_fs[i] + 1;
+    const int to = i + 1 < m_fs.size() ? m_fs[i + 1] : m_end;
+    return QByteArray::fromRawData(m_frame.constData() + from, to - from);
+}
+
+int ReplyView::fieldToInt(const int i, bool *ok) const
+{
+    return toInt(field(i), ok);
+}
+
+QByteArray ReplyView::mid(const int pos, const int len) const
+{
+    const int end = len < 0 ? m_end : qMin(pos + len, m_frame.size());
+    if(pos < 0 || pos >= end)
+        return QByteArray();
+
+    return QByteArray::fromRawData(m_frame.constData() + pos, end - pos);
+}
+
+int ReplyView::indexOf(const char c, const int from) const
+{
+    return m_frame.indexOf(c, from);
+}
+
+int ReplyView::hexWord(const int pos, bool *ok) const
+{
+    if(ok)
+        *ok = false;
+    if(pos < 0 || pos + 4 > m_frame.size())
+        return 0;
+
+    int value = 0;
+    for(int i = pos; i < pos + 4; i++) {
+        const char c = m_frame.at(i);
+        int digit;
+        if(c >= '0' && c <= '9')
+            digit = c - '0';
+        else if(c >= 'a' && c <= 'f')
+            digit = c - 'a' + 10;
+        else if(c >= 'A' && c <= 'F')
+            digit = c - 'A' + 10;
+        else
+            return 0;
+        value = (value << 4) | digit;
+    }
+
+    if(ok)
+        *ok = true;
+    return value;
+}
+
+int ReplyView::binaryWord(const int pos) const
+{
+    if(pos < 0 || pos + 2 > m_frame.size())
+        return 0;
+
+    return (uchar(m_frame.at(pos)) << 8) | uchar(m_frame.at(pos + 1));
+}
+
+int ReplyView::toInt(const QByteArray &text, bool *ok)
+{
+    const char *d = text.constData();
+    int from = 0;
+    int to = text.size();
+
+    while(from < to && isBlank(d[from]))
+        from++;
+    while(to > from && isBlank(d[to - 1]))
+        to--;
+
+    bool negative = false;
+    if(from < to && (d[from] == '-' || d[from] == '+'))
+        negative = d[from++] == '-';
+
+    if(ok)
+        *ok = false;
+    if(from == to)
+        return 0;
+
+    qint64 value = 0;
+    for(int i = from; i < to; i++) {
+        if(d[i] < '0' || d[i] > '9')
+            return 0;
+        value = value * 10 + (d[i] - '0');
+        if(value > INT_MAX)
+            return 0;
+    }
+
+    if(ok)
+        *ok = true;
+    return negative ? -int(value) : int(value);
+}
@@ -0,0 +1,73 @@
+/*
+*
+* Copyright (C)2018, Samuel Isuani <sisuani@gmail.com>
+* All rights reserved.
+*
+* Redistribution and use in source and binary forms, with or without
+* modification, are permitted provided that the following conditions
+* are met:
+*
+* Redistributions of source code must retain the above copyright notice,
+* this list of conditions and the following disclaimer.
+*
+* Redistributions in binary form must reproduce the above copyright
+* notice, this list of conditions and the following disclaimer in the
+* documentation and/or other materials provided with the distribution.
+*
+* Neither the name of the project's author nor the names of its
+* contributors may be used to endorse or promote products derived from
+* this software without specific prior written permission.
+*
+* THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+* "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+* LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+* FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+* HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+* SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED
+* TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+* PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+* LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+* NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+* SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*
+*/
+
+
+#ifndef REPLYVIEW_H
+#define REPLYVIEW_H
+
+#include <QByteArray>
+#include <QVarLengthArray>
+
+// Read-only view over a printer reply, STX ... ETX + 4 checksum chars.
+// The FS separators are indexed once; field() and mid() hand out raw
+// QByteArrays pointing into the reply, valid while this view lives.
+class ReplyView
+{
+
+public:
+    explicit ReplyView(const QByteArray &frame);
+
+    int size() const;
+
+    // field 0 is SEQ+CMD, the ETX and checksum are not part of the last one
+    int fieldCount() const;
+    QByteArray field(const int i) const;
+    int fieldToInt(const int i, bool *ok = 0) const;
+
+    // by offset, len -1 runs up to the ETX
+    QByteArray mid(const int pos, const int len = -1) const;
+    int indexOf(const char c, const int from = 0) const;
+    int hexWord(const int pos, bool *ok = 0) const;     // 4 ascii hex digits
+    int binaryWord(const int pos) const;                // 2 bytes, big endian
+
+    // decimal number, surrounding blanks ignored
+    static int toInt(const QByteArray &text, bool *ok = 0);
+
+private:
+    QByteArray m_frame;
+    int m_end;
+    QVarLengthArray<int, 16> m_fs;
+};
+
+#endif // REPLYVIEW_H
@@ -0,0 +1,299 @@
+/*
+*
+* Copyright (C)2018, Samuel Isuani <sisuani@gmail.com>
+* All rights reserved.
+*
+* Redistribution and use in source and binary forms, with or without
+* modification, are permitted provided that the following conditions
+* are met:
+*
+* Redistributions of source code must retain the above copyright notice,
+* this list of conditions and the following disclaimer.
+*
+* Redistributions in binary form must reproduce the above copyright
+* notice, this list of conditions and the following disclaimer in the
+* documentation and/or other materials provided with the distribution.
+*
+* Neither the name of the project's author nor the names of its
+* contributors may be used to endorse or promote products derived from
+* this software without specific prior written permission.
+*
+* THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+* "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+* LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+* FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+* HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+* SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED
+* TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+* PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+* LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+* NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+* SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*
+*/
+
+
+#include "reportarchive.h"
+#include "logger.h"
+
+#include <QDataStream>
+#include <QMutexLocker>
+
+#if defined (Q_OS_UNIX)
+#include <unistd.h>
+#elif defined (Q_OS_WIN32)
+#include <io.h>
+#endif
+
+static const char FILE_MAGIC[] = "QFPA";
+static const quint32 FILE_VERSION = 1;
+static const int FILE_HEADER = 8;
+
+// magic day flags typelen checksum size raw, then type and payload
+static const quint32 CHUNK_MAGIC = 0x51464143;
+static const int CHUNK_HEADER = 20;
+static const quint8 CHUNK_LAST = 0x01;
+
+// raw bytes per chunk, big enough for zlib, small enough to read one alone
+static const int CHUNK_SIZE = 64 * 1024;
+
+ReportArchive::ReportArchive(const QString &path, QObject *parent)
+    : QIODevice(parent)
+    , m_file(path)
+    , m_valid(false)
+    , m_start(-1)
+{
+    if (!m_file.open(QIODevice::ReadWrite))
+        return;
+
+    if (m_file.size() == 0) {
+        QByteArray header(FILE_MAGIC, 4);
+        QDataStream s(&header, QIODevice::Append);
+        s << FILE_VERSION;
+        m_valid = m_file.write(header) == FILE_HEADER;
+        sync();
+        return;
+    }
+
+    m_valid = scan();
+
+#ifdef DEBUG
+    log << QString("ReportArchive() -> %1 types in %2, valid %3")
+        .arg(m_index.size()).arg(path).arg(m_valid);
+#endif
+}
+
+bool ReportArchive::isValid() const
+{
+    return m_valid;
+}
+
+bool ReportArchive::isSequential() const
+{
+    return true;
+}
+
+bool ReportArchive::scan()
+{
+    const QByteArray header = m_file.read(FILE_HEADER);
+    if (header.size() != FILE_HEADER || !header.startsWith(FILE_MAGIC))
+        return false;
+
+    const qint64 size = m_file.size();
+    qint64 pos = FILE_HEADER;
+    qint64 end = pos; // after the last complete report
+    QList<Chunk> chunks;
+
+    while (pos + CHUNK_HEADER <= size) {
+        m_file.seek(pos);
+        QDataStream s(m_file.read(CHUNK_HEADER));
+        quint32 magic, day, payload, raw;
+        quint8 flags, typeLen;
+        quint16 checksum;
+        s >> magic >> day >> flags >> typeLen >> checksum >> payload >> raw;
+        Q_UNUSED(raw);
+
+        const qint64 next = pos + CHUNK_HEADER + typeLen + payload;
+        if (magic != CHUNK_MAGIC || next > size)
+            break;
+
+        const QString type = QString::fromLatin1(m_file.read(typeLen));
+        Chunk chunk;
+        chunk.offset = pos + CHUNK_HEADER + typeLen;
+        chunk.size = payload;
+        chunk.checksum = checksum;
+        chunks.append(chunk);
+
+        if (flags & CHUNK_LAST) {
+            m_index[type][QDate::fromJulianDay(day)] = chunks;
+            chunks.clear();
+            end = next;
+        }
+        pos = next;
+    }
+
+    if (end < size) {
+#ifdef DEBUG
+        log << QString("ReportArchive::scan() -> dropping %1 bytes of an unfinished report").arg(size - end);
+#endif
+        m_file.resize(end);
+        sync();
+    }
+    return true;
+}
+
+bool ReportArchive::begin(const QString &type, const QDate &day)
+{
+    if (!m_valid || isOpen() || type.isEmpty() || type.size() > 255)
+        return false;
+
+    m_type = type;
+    m_day = day;
+    m_start = m_file.size();
+    m_chunks.clear();
+    m_buffer.clear();
+    return QIODevice::open(QIODevice::WriteOnly);
+}
+
+bool ReportArchive::commit()
+{
+    if (!isOpen())
+        return false;
+
+    const bool ok = writeChunk(true);
+    if (!ok) {
+        abort();
+        return false;
+    }
+    sync();
+
+    QMutexLocker locker(&m_mutex);
+    // a later copy of the same day wins
+    m_index[m_type][m_day] = m_chunks;
+    m_chunks.clear();
+    QIODevice::close();
+    return true;
+}
+
+void ReportArchive::abort()
+{
+    if (!isOpen())
+        return;
+
+    QMutexLocker locker(&m_mutex);
+    m_file.resize(m_start);
+    m_chunks.clear();
+    m_buffer.clear();
+    QIODevice::close();
+}
+
+qint64 ReportArchive::readData(char *data, qint64 maxSize)
+{
+    Q_UNUSED(data);
+    Q_UNUSED(maxSize);
+    return -1;
+}
+
+qint64 ReportArchive::writeData(const char *data, qint64 size)
+{
+    m_buffer.append(data, size);
+    while (m_buffer.size() >= CHUNK_SIZE) {
+        if (!writeChunk(false))
+            return -1;
+    }
+    return size;
+}
+
+bool ReportArchive::writeChunk(const bool last)
+{
+    const QByteArray raw = m_buffer.left(CHUNK_SIZE);
+    const QByteArray payload = qCompress(raw, 9);
+    const QByteArray type = m_type.toLatin1();
+    const QByteArray summed = type + payload;
+    const quint16 checksum = qChecksum(summed.constData(), summed.size());
+
+    QByteArray header;
+    QDataStream s(&header, QIODevice::WriteOnly);
+    s << CHUNK_MAGIC << quint32(m_day.toJulianDay()) << quint8(last ? CHUNK_LAST : 0)
+      << quint8(type.size()) << checksum << quint32(payload.size()) << quint32(raw.size());
+
+    QMutexLocker locker(&m_mutex);
+    const qint64 pos = m_file.size();
+    m_file.seek(pos);
+    if (m_file.write(header + summed) != CHUNK_HEADER + summed.size())
+        return false;
+
+    Chunk chunk;
+    chunk.offset = pos + CHUNK_HEADER + type.size();
+    chunk.size = payload.size();
+    chunk.checksum = checksum;
+    m_chunks.append(chunk);
+    // writeData() leaves less than a chunk for the last one
+    m_buffer.remove(0, raw.size());
+    return true;
+}
+
+bool ReportArchive::readChunk(const QString &type, const Chunk &chunk, QByteArray *data) const
+{
+    m_file.seek(chunk.offset);
+    const QByteArray payload = m_file.read(chunk.size);
+    const QByteArray summed = type.toLatin1() + payload;
+    if (payload.size() != int(chunk.size) || qChecksum(summed.constData(), summed.size()) != chunk.checksum) {
+#ifdef DEBUG
+        log << QString("ReportArchive::readChunk() -> bad checksum at %1").arg(chunk.offset);
+#endif
+        return false;
+    }
+    *data = qUncompress(payload);
+    return true;
+}
+
+QList<QDate> ReportArchive::days(const QString &type) const
+{
+    QMutexLocker locker(&m_mutex);
+    return m_index.value(type).keys();
+}
+
+bool ReportArchive::contains(const QString &type, const QDate &day) const
+{
+    QMutexLocker locker(&m_mutex);
+    return m_index.value(type).contains(day);
+}
+
+QByteArray ReportArchive::report(const QString &type, const QDate &day) const
+{
+    QMutexLocker locker(&m_mutex);
+    QByteArray report;
+    QByteArray data;
+    foreach (const Chunk &chunk, m_index.value(type).value(day)) {
+        if (!readChunk(type, chunk, &data))
+            return QByteArray();
+        report.append(data);
+    }
+    return report;
+}
+
+bool ReportArchive::extract(const QString &type, const QDate &from, const QDate &to, QIODevice *out) const
+{
+    QMutexLocker locker(&m_mutex);
+    const QMap<QDate, QList<Chunk> > days = m_index.value(type);
+    QByteArray data;
+    for (QMap<QDate, QList<Chunk> >::const_iterator it = days.lowerBound(from);
+            it != days.end() && it.key() <= to; ++it) {
+        foreach (const Chunk &chunk, it.value()) {
+            if (!readChunk(type, chunk, &data) || out->write(data) != data.size())
+                return false;
+        }
+    }
+    return true;
+}
+
+void ReportArchive::sync()
+{
+    m_file.flush();
+#if defined (Q_OS_UNIX)
+    fsync(m_file.handle());
+#elif defined (Q_OS_WIN32)
+    _commit(m_file.handle());
+#endif
+}
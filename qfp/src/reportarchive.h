@@ -0,0 +1,103 @@
+/*
+*
+* Copyright (C)2018, Samuel Isuani <sisuani@gmail.com>
+* All rights reserved.
+*
+* Redistribution and use in source and binary forms, with or without
+* modification, are permitted provided that the following conditions
+* are met:
+*
+* Redistributions of source code must retain the above copyright notice,
+* this list of conditions and the following disclaimer.
+*
+* Redistributions in binary form must reproduce the above copyright
+* notice, this list of conditions and the following disclaimer in the
+* documentation and/or other materials provided with the distribution.
+*
+* Neither the name of the project's author nor the names of its
+* contributors may be used to endorse or promote products derived from
+* this software without specific prior written permission.
+*
+* THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+* "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+* LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+* FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+* HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+* SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED
+* TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+* PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+* LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+* NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+* SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*
+*/
+
+
+#ifndef REPORTARCHIVE_H
+#define REPORTARCHIVE_H
+
+#include <QIODevice>
+#include <QDate>
+#include <QFile>
+#include <QHash>
+#include <QMap>
+#include <QMutex>
+
+// Append-only archive of downloaded reports, one file per printer. A
+// report is stored as qCompress()ed chunks, each with its own header and
+// checksum. Opening only walks the chunk headers to build the index,
+// a report cut short by a crash is dropped from the end of the file.
+//
+// Between begin() and commit() the archive is the write-only sink of
+// one report, e.g. out device of the PemDecoder given to
+// FiscalPrinter::downloadReportByDate().
+class ReportArchive : public QIODevice
+{
+    Q_OBJECT
+
+public:
+    explicit ReportArchive(const QString &path, QObject *parent = 0);
+
+    bool isValid() const;
+    bool isSequential() const;
+
+    bool begin(const QString &type, const QDate &day);
+    bool commit();
+    void abort(); // drops what was written since begin()
+
+    QList<QDate> days(const QString &type) const;
+    bool contains(const QString &type, const QDate &day) const;
+    QByteArray report(const QString &type, const QDate &day) const;
+    // every day of type in [from, to] in order, false on a bad checksum
+    bool extract(const QString &type, const QDate &from, const QDate &to, QIODevice *out) const;
+
+protected:
+    qint64 readData(char *data, qint64 maxSize);
+    qint64 writeData(const char *data, qint64 size);
+
+private:
+    struct Chunk {
+        qint64 offset;  // of the payload
+        quint32 size;
+        quint16 checksum;
+    };
+
+    bool scan();
+    bool writeChunk(const bool last);
+    bool readChunk(const QString &type, const Chunk &chunk, QByteArray *data) const;
+    void sync();
+
+    mutable QFile m_file;
+    mutable QMutex m_mutex;
+    bool m_valid;
+    QHash<QString, QMap<QDate, QList<Chunk> > > m_index;
+
+    // report being written
+    QString m_type;
+    QDate m_day;
+    qint64 m_start;
+    QList<Chunk> m_chunks;
+    QByteArray m_buffer;
+};
+
+#endif // REPORTARCHIVE_H
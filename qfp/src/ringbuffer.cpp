@@ -0,0 +1,180 @@
+/*
+*
+* Copyright (C)2018, Samuel Isuani <sisuani@gmail.com>
+* All rights reserved.
+*
+* Redistribution and use in source and binary forms, with or without
+* modification, are permitted provided that the following conditions
+* are met:
+*
+* Redistributions of source code must retain the above copyright notice,
+* this list of conditions and the following disclaimer.
+*
+* Redistributions in binary form must reproduce the above copyright
+* notice, this list of conditions and the following disclaimer in the
+* documentation and/or other materials provided with the distribution.
+*
+* Neither the name of the project's author nor the names of its
+* contributors may be used to endorse or promote products derived from
+* this software without specific prior written permission.
+*
+* THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+* "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+* LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+* FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+* HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+* SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED
+* TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+* PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+* LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+* NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+* SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*
+*/
+
+
+#include "ringbuffer.h"
+
+#include <string.h>
+
+RingBuffer::RingBuffer(int capacity)
+    : m_head(0)
+    , m_size(0)
+{
+    int c = 16;
+    while (c < capacity)
+        c <<= 1;
+    m_buffer.resize(c);
+    m_mask = c - 1;
+}
+
+int RingBuffer::size() const
+{
+    return m_size;
+}
+
+int RingBuffer::capacity() const
+{
+    return m_mask + 1;
+}
+
+bool RingBuffer::isEmpty() const
+{
+    return m_size == 0;
+}
+
+void RingBuffer::clear()
+{
+    m_head = 0;
+    m_size = 0;
+}
+
+const char *RingBuffer::readPointer(int *size) const
+{
+    *size = qMin(m_size, capacity() - m_head);
+    return m_buffer.constData() + m_head;
+}
+
+char *RingBuffer::writePointer(int *size)
+{
+    const int tail = (m_head + m_size) & m_mask;
+    if (m_size == capacity())
+        *size = 0;
+    else if (tail >= m_head)
+        *size = capacity() - tail;
+    else
+        *size = m_head - tail;
+    return m_buffer.data() + tail;
+}
+
+void RingBuffer::commit(int size)
+{
+    m_size += qMin(size, capacity() - m_size);
+}
+
+void RingBuffer::skip(int size)
+{
+    size = qMin(size, m_size);
+    m_head = (m_head + size) & m_mask;
+    m_size -= size;
+    if (m_size == 0)
+        m_head = 0;
+}
+
+bool RingBuffer::getChar(char *c)
+{
+    if (m_size == 0)
+        return false;
+    *c = m_buffer.constData()[m_head];
+    skip(1);
+    return true;
+}
+
+int RingBuffer::peek(char *data, int maxSize) const
+{
+    const int n = qMin(maxSize, m_size);
+    const int first = qMin(n, capacity() - m_head);
+    memcpy(data, m_buffer.constData() + m_head, first);
+    memcpy(data + first, m_buffer.constData(), n - first);
+    return n;
+}
+
+int RingBuffer::indexOf(char c) const
+{
+    const int first = qMin(m_size, capacity() - m_head);
+    const char *p = m_buffer.constData();
+    const char *hit = static_cast<const char *>(memchr(p + m_head, c, first));
+    if (hit)
+        return hit - (p + m_head);
+    hit = static_cast<const char *>(memchr(p, c, m_size - first));
+    if (hit)
+        return first + (hit - p);
+    return -1;
+}
+
+int RingBuffer::read(char *data, int maxSize)
+{
+    const int n = peek(data, maxSize);
+    skip(n);
+    return n;
+}
+
+QByteArray RingBuffer::read(int maxSize)
+{
+    QByteArray r;
+    r.resize(qMin(maxSize, m_size));
+    read(r.data(), r.size());
+    return r;
+}
+
+void RingBuffer::append(const char *data, int size)
+{
+    reserve(size);
+    while (size > 0) {
+        int room;
+        char *p = writePointer(&room);
+        room = qMin(room, size);
+        memcpy(p, data, room);
+        commit(room);
+        data += room;
+        size -= room;
+    }
+}
+
+void RingBuffer::reserve(int size)
+{
+    if (capacity() - m_size >= size)
+        return;
+
+    int c = capacity();
+    while (c - m_size < size)
+        c <<= 1;
+
+    // linearize into the new storage so the head restarts at zero
+    QByteArray buffer;
+    buffer.resize(c);
+    peek(buffer.data(), m_size);
+    m_buffer = buffer;
+    m_head = 0;
+    m_mask = c - 1;
+}
@@ -0,0 +1,76 @@
+/*
+*
+* Copyright (C)2018, Samuel Isuani <sisuani@gmail.com>
+* All rights reserved.
+*
+* Redistribution and use in source and binary forms, with or without
+* modification, are permitted provided that the following conditions
+* are met:
+*
+* Redistributions of source code must retain the above copyright notice,
+* this list of conditions and the following disclaimer.
+*
+* Redistributions in binary form must reproduce the above copyright
+* notice, this list of conditions and the following disclaimer in the
+* documentation and/or other materials provided with the distribution.
+*
+* Neither the name of the project's author nor the names of its
+* contributors may be used to endorse or promote products derived from
+* this software without specific prior written permission.
+*
+* THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+* "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+* LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+* FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+* HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+* SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED
+* TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+* PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+* LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+* NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+* SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*
+*/
+
+
+#ifndef RINGBUFFER_H
+#define RINGBUFFER_H
+
+#include <QByteArray>
+
+// Receive buffer for the connector. The port is drained into it in bulk and
+// the drivers consume bytes in place through readPointer()/skip().
+class RingBuffer
+{
+
+public:
+    explicit RingBuffer(int capacity = 4096);
+
+    int size() const;
+    int capacity() const;
+    bool isEmpty() const;
+    void clear();
+
+    // contiguous readable/writable regions, valid until the next call
+    const char *readPointer(int *size) const;
+    char *writePointer(int *size);
+    void commit(int size);
+    void skip(int size);
+
+    bool getChar(char *c);
+    int peek(char *data, int maxSize) const;
+    int indexOf(char c) const;
+    int read(char *data, int maxSize);
+    QByteArray read(int maxSize);
+    void append(const char *data, int size);
+    void reserve(int size); // make room for size more bytes
+
+private:
+
+    QByteArray m_buffer;
+    int m_head;
+    int m_size;
+    int m_mask;
+};
+
+#endif // RINGBUFFER_H
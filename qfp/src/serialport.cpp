@@ -55,6 +55,8 @@ SerialPort::SerialPort(const QString &type, unsigned int port, const QString &se
     }
 #endif
 
+    // Polling: the drivers read from their own thread without an event loop and
+    // block in waitForReadyRead() instead of sleeping between reads.
     m_serialPort = new QextSerialPort(v_port, QextSerialPort::Polling);
     if (!settings.isEmpty() && settings.compare("b115200") == 0)
         m_serialPort->setBaudRate(BAUD115200);
@@ -93,6 +95,11 @@ QByteArray SerialPort::read(const qreal size)
     return m_serialPort->read(size);
 }
 
+qint64 SerialPort::read(char *data, const qint64 maxSize)
+{
+    return m_serialPort->read(data, maxSize);
+}
+
 QByteArray SerialPort::readAll()
 {
     return m_serialPort->readAll();
@@ -102,3 +109,13 @@ const qreal SerialPort::bytesAvailable()
 {
     return m_serialPort->bytesAvailable();
 }
+
+bool SerialPort::waitForReadyRead(const int msecs)
+{
+    return m_serialPort->waitForReadyRead(msecs);
+}
+
+void SerialPort::abortWait()
+{
+    m_serialPort->abortWait();
+}
@@ -48,8 +48,11 @@ public:
 
     const qreal write(const QByteArray &data);
     QByteArray read(const qreal size);
+    qint64 read(char *data, const qint64 maxSize);
     QByteArray readAll();
     const qreal bytesAvailable();
+    bool waitForReadyRead(const int msecs);
+    void abortWait();
 
 private:
     QextSerialPort *m_serialPort;
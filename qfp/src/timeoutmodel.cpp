@@ -0,0 +1,86 @@
+/*
+*
+* Copyright (C)2018, Samuel Isuani <sisuani@gmail.com>
+* All rights reserved.
+*
+* Redistribution and use in source and binary forms, with or without
+* modification, are permitted provided that the following conditions
+* are met:
+*
+* Redistributions of source code must retain the above copyright notice,
+* this list of conditions and the following disclaimer.
+*
+* Redistributions in binary form must reproduce the above copyright
+* notice, this list of conditions and the following disclaimer in the
+* documentation and/or other materials provided with the distribution.
+*
+* Neither the name of the project's author nor the names of its
+* contributors may be used to endorse or promote products derived from
+* this software without specific prior written permission.
+*
+* THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+* "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+* LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+* FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+* HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+* SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED
+* TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+* PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+* LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+* NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+* SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*
+*/
+
+
+#include "timeoutmodel.h"
+
+#include <QMutexLocker>
+
+TimeoutModel::TimeoutModel()
+{
+}
+
+int TimeoutModel::timeout(const int cmd, const int floor)
+{
+    QMutexLocker locker(&m_mutex);
+    const Estimate e = m_estimates.value(cmd);
+
+    if(e.samples < MIN_SAMPLES)
+        return MAX_TIMEOUT;
+
+    const int rto = int(e.srtt + 4 * e.rttvar) * e.backoff;
+    return qBound(floor, rto, int(MAX_TIMEOUT));
+}
+
+void TimeoutModel::addSample(const int cmd, const int msecs)
+{
+    QMutexLocker locker(&m_mutex);
+    Estimate &e = m_estimates[cmd];
+
+    if(e.samples == 0) {
+        e.srtt = msecs;
+        e.rttvar = msecs / 2.0;
+    } else {
+        // alpha = 1/8, beta = 1/4
+        e.rttvar = 0.75 * e.rttvar + 0.25 * qAbs(e.srtt - msecs);
+        e.srtt = 0.875 * e.srtt + 0.125 * msecs;
+    }
+
+    e.samples++;
+    e.backoff = 1;
+}
+
+void TimeoutModel::timedOut(const int cmd)
+{
+    QMutexLocker locker(&m_mutex);
+    Estimate &e = m_estimates[cmd];
+    if(e.backoff < MAX_TIMEOUT)
+        e.backoff *= 2;
+}
+
+void TimeoutModel::reset()
+{
+    QMutexLocker locker(&m_mutex);
+    m_estimates.clear();
+}
@@ -0,0 +1,77 @@
+/*
+*
+* Copyright (C)2018, Samuel Isuani <sisuani@gmail.com>
+* All rights reserved.
+*
+* Redistribution and use in source and binary forms, with or without
+* modification, are permitted provided that the following conditions
+* are met:
+*
+* Redistributions of source code must retain the above copyright notice,
+* this list of conditions and the following disclaimer.
+*
+* Redistributions in binary form must reproduce the above copyright
+* notice, this list of conditions and the following disclaimer in the
+* documentation and/or other materials provided with the distribution.
+*
+* Neither the name of the project's author nor the names of its
+* contributors may be used to endorse or promote products derived from
+* this software without specific prior written permission.
+*
+* THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+* "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+* LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+* FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+* HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+* SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED
+* TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+* PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+* LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+* NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+* SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*
+*/
+
+
+#ifndef TIMEOUTMODEL_H
+#define TIMEOUTMODEL_H
+
+#include <QHash>
+#include <QMutex>
+
+// Learns how long each command takes to answer on one printer and hands
+// out a deadline for the next read: srtt + 4 * rttvar, as in RFC 6298.
+// Every driver keeps its own, printers of a model may sit on slow links.
+class TimeoutModel
+{
+
+public:
+    TimeoutModel();
+
+    // deadline in ms, never below floor nor above the hard cap
+    int timeout(const int cmd, const int floor);
+    // msecs from the frame going out (or the printer being free) to its reply
+    void addSample(const int cmd, const int msecs);
+    // the printer did not answer in time, back off until it does
+    void timedOut(const int cmd);
+    void reset();
+
+    enum {
+        MAX_TIMEOUT = 15000,    // the old flat worst case
+        MIN_SAMPLES = 3         // use MAX_TIMEOUT until learned
+    };
+
+private:
+    struct Estimate {
+        Estimate() : srtt(0), rttvar(0), samples(0), backoff(1) {}
+        qreal srtt;
+        qreal rttvar;
+        int samples;
+        int backoff;
+    };
+
+    QMutex m_mutex;
+    QHash<int, Estimate> m_estimates;
+};
+
+#endif // TIMEOUTMODEL_H
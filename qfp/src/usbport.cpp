@@ -111,3 +111,10 @@ const qreal UsbPort::bytesAvailable()
 {
     return 0;
 }
+
+bool UsbPort::waitForReadyRead(const int msecs)
+{
+    Q_UNUSED(msecs);
+    // bulk reads block on the endpoint, there is nothing to wait for here
+    return m_open;
+}
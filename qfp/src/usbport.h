@@ -53,6 +53,7 @@ public:
     QByteArray read(const qreal size);
     QByteArray readAll();
     const qreal bytesAvailable();
+    bool waitForReadyRead(const int msecs);
 
 private:
     bool m_open;
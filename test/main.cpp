@@ -1,14 +1,31 @@
 #include <QCoreApplication>
 
 #include "commandlinethread.h"
+#include "spooler.h"
 
 
 int main(int argc, char *argv[])
 {
     QCoreApplication app(argc, argv);
 
+    if(argc >= 4 && QString(argv[1]).compare("--spool") == 0) {
+        Spooler spooler;
+        for(int i = 3; i < argc; i++) {
+            if(!spooler.addPrinter(argv[i])) {
+                qDebug() << "Bad printer:" << argv[i];
+                return 1;
+            }
+        }
+        if(!spooler.listen(argv[2])) {
+            qDebug() << "Can't listen on" << argv[2];
+            return 1;
+        }
+        return app.exec();
+    }
+
     if(argc < 5) {
         qDebug() << "Usage: ./fp brand model host port baudios";
+        qDebug() << "       ./fp --spool socket name,brand,model,host,port[,baudios] ...";
         return 0;
     }
 
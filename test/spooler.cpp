@@ -0,0 +1,143 @@
+#include <QDebug>
+#include <QLocalServer>
+#include <QLocalSocket>
+#include <QStringList>
+#include <QJson/Parser>
+#include <QJson/Serializer>
+
+#include "spooler.h"
+#include "spoolerlane.h"
+
+Spooler::Spooler(QObject *parent)
+    : QObject(parent)
+    , m_nextClient(0)
+{
+    m_server = new QLocalServer(this);
+    m_pool = new FiscalPrinterPool(this);
+    connect(m_server, SIGNAL(newConnection()), this, SLOT(newConnection()));
+}
+
+Spooler::~Spooler()
+{
+    foreach (SpoolerLane *lane, m_lanes)
+        lane->stop();
+    // cancels whatever the lanes are still waiting for
+    delete m_pool;
+    foreach (SpoolerLane *lane, m_lanes) {
+        lane->wait();
+        delete lane;
+    }
+}
+
+bool Spooler::addPrinter(const QString &spec)
+{
+    const QStringList f = spec.split(',');
+    if (f.size() < 5 || m_lanes.contains(f.at(0)))
+        return false;
+
+    FiscalPrinter::Brand brand;
+    FiscalPrinter::Model model;
+    if (f.at(1).compare("epson") == 0) {
+        brand = FiscalPrinter::Epson;
+        model = f.at(2).compare("900") == 0 ? FiscalPrinter::EpsonTM900 : FiscalPrinter::EpsonTMU220;
+    } else {
+        brand = FiscalPrinter::Hasar;
+        if (f.at(2).compare("320") == 0)
+            model = FiscalPrinter::Hasar320F;
+        else if (f.at(2).compare("330") == 0)
+            model = FiscalPrinter::Hasar330F;
+        else if (f.at(2).compare("615") == 0)
+            model = FiscalPrinter::Hasar615F;
+        else if (f.at(2).compare("5100") == 0 || f.at(2).compare("1000") == 0 || f.at(2).compare("250") == 0)
+            model = FiscalPrinter::Hasar1000F;
+        else
+            model = FiscalPrinter::Hasar715F;
+    }
+
+    FiscalPrinter *fp = m_pool->addPrinter(f.at(0), brand, model, f.at(3), f.at(4), f.value(5), 400);
+    SpoolerLane *lane = new SpoolerLane(0, fp);
+    connect(lane, SIGNAL(result(int, const QVariantMap &)), this, SLOT(result(int, const QVariantMap &)));
+    m_lanes.insert(f.at(0), lane);
+    lane->start();
+    qDebug() << "SPOOLER: printer" << f.at(0) << "open" << fp->isOpen();
+    return true;
+}
+
+bool Spooler::listen(const QString &path)
+{
+    // a socket left behind by a previous run
+    QLocalServer::removeServer(path);
+    return m_server->listen(path);
+}
+
+void Spooler::newConnection()
+{
+    while (QLocalSocket *socket = m_server->nextPendingConnection()) {
+        const int client = ++m_nextClient;
+        socket->setProperty("client", client);
+        m_clients.insert(client, socket);
+        connect(socket, SIGNAL(readyRead()), this, SLOT(readClient()));
+        connect(socket, SIGNAL(disconnected()), this, SLOT(clientGone()));
+    }
+}
+
+void Spooler::readClient()
+{
+    QLocalSocket *socket = qobject_cast<QLocalSocket *>(sender());
+    if (!socket)
+        return;
+
+    while (socket->canReadLine()) {
+        const QByteArray line = socket->readLine().trimmed();
+        if (line.isEmpty())
+            continue;
+
+        QJson::Parser parser;
+        bool ok = true;
+        const QVariantMap job = parser.parse(line, &ok).toMap();
+
+        QVariantMap error;
+        error["id"] = job["id"];
+        error["done"] = true;
+        error["ok"] = false;
+        if (!ok) {
+            error["error"] = "parse";
+            reply(socket, error);
+            continue;
+        }
+
+        SpoolerLane *lane = m_lanes.value(job["printer"].toString());
+        if (!lane) {
+            error["error"] = "unknown printer";
+            reply(socket, error);
+            continue;
+        }
+
+        lane->enqueue(socket->property("client").toInt(), job);
+    }
+}
+
+void Spooler::clientGone()
+{
+    QLocalSocket *socket = qobject_cast<QLocalSocket *>(sender());
+    if (!socket)
+        return;
+
+    // its jobs still print, the results have nowhere to go
+    m_clients.remove(socket->property("client").toInt());
+    socket->deleteLater();
+}
+
+void Spooler::result(int client, const QVariantMap &line)
+{
+    QLocalSocket *socket = m_clients.value(client);
+    if (socket)
+        reply(socket, line);
+}
+
+void Spooler::reply(QLocalSocket *socket, const QVariantMap &line)
+{
+    QJson::Serializer serializer;
+    serializer.setIndentMode(QJson::IndentCompact);
+    socket->write(serializer.serialize(line) + '\n');
+}
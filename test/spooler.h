@@ -0,0 +1,51 @@
+#ifndef SPOOLER_H
+#define SPOOLER_H
+
+#include <QObject>
+#include <QMap>
+#include <QHash>
+#include <QVariantMap>
+
+#include "../qfp/src/fiscalprinterpool.h"
+
+class QLocalServer;
+class QLocalSocket;
+class SpoolerLane;
+
+// Print spooler for many POS clients on a local socket. One JSON object
+// per line each way:
+//
+//  -> {"id": "1", "printer": "caja1", "commands": [["openFiscalReceipt", "T"],
+//      ["printLineItem", "Coca", 1, 10.5, "21.00", "M"], ["closeFiscalReceipt", "T", "T", 7]]}
+//  <- {"id": "1", "step": 0, "ok": true, "printer": 0, "fiscal": 0}
+//  <- ...
+//  <- {"id": "1", "done": true, "ok": true, "number": 1234}
+class Spooler : public QObject
+{
+    Q_OBJECT
+
+public:
+    Spooler(QObject *parent = 0);
+    ~Spooler();
+
+    // "name,brand,model,host,port[,baudios]", brand and model as for ./fp
+    bool addPrinter(const QString &spec);
+    bool listen(const QString &path);
+
+private slots:
+    void newConnection();
+    void readClient();
+    void clientGone();
+    void result(int client, const QVariantMap &line);
+
+private:
+    void reply(QLocalSocket *socket, const QVariantMap &line);
+
+    QLocalServer *m_server;
+    FiscalPrinterPool *m_pool;
+    QMap<QString, SpoolerLane *> m_lanes;
+    QHash<int, QLocalSocket *> m_clients;
+    int m_nextClient;
+};
+
+#endif
@@ -0,0 +1,169 @@
+#include <QDateTime>
+
+#include "spoolerlane.h"
+
+static const char *commands[] = {
+    "statusRequest", "dailyClose", "setCustomerData", "openFiscalReceipt",
+    "printFiscalText", "printLineItem", "perceptions", "subtotal", "totalTender",
+    "generalDiscount", "closeFiscalReceipt", "openNonFiscalReceipt",
+    "printNonFiscalText", "closeNonFiscalReceipt", "openDrawer", "setHeaderTrailer",
+    "setEmbarkNumber", "openDNFH", "printEmbarkItem", "closeDNFH", "cancel",
+    "setDateTime", 0
+};
+
+static char toChar(const QVariant &v)
+{
+    const QString s = v.toString();
+    return s.isEmpty() ? ' ' : s.at(0).toLatin1();
+}
+
+SpoolerLane::SpoolerLane(QObject *parent, FiscalPrinter *fp)
+    : QThread(parent)
+    , fp(fp)
+{
+    m_continue = true;
+}
+
+bool SpoolerLane::isKnown(const QString &command)
+{
+    for (int i = 0; commands[i]; i++) {
+        if (command.compare(commands[i]) == 0)
+            return true;
+    }
+    return false;
+}
+
+void SpoolerLane::enqueue(int client, const QVariantMap &job)
+{
+    QMutexLocker locker(&m_mutex);
+    m_jobs.enqueue(qMakePair(client, job));
+    m_queued.wakeOne();
+}
+
+void SpoolerLane::stop()
+{
+    QMutexLocker locker(&m_mutex);
+    m_continue = false;
+    m_jobs.clear();
+    m_queued.wakeOne();
+}
+
+void SpoolerLane::run()
+{
+    while (true) {
+        QPair<int, QVariantMap> job;
+        {
+            QMutexLocker locker(&m_mutex);
+            while (m_continue && m_jobs.isEmpty())
+                m_queued.wait(&m_mutex);
+            if (!m_continue)
+                return;
+            job = m_jobs.dequeue();
+        }
+        execute(job.first, job.second);
+    }
+}
+
+void SpoolerLane::execute(int client, const QVariantMap &job)
+{
+    const QVariantList list = job["commands"].toList();
+    QVariantMap done;
+    done["id"] = job["id"];
+    done["done"] = true;
+
+    // nothing goes to the printer unless the whole job makes sense
+    for (int i = 0; i < list.size(); i++) {
+        const QString name = list.at(i).toList().value(0).toString();
+        if (!isKnown(name)) {
+            done["ok"] = false;
+            done["error"] = QString("unknown command %1").arg(name);
+            emit result(client, done);
+            return;
+        }
+    }
+
+    // queued back to back, the driver sends them without waiting on us
+    QList<FiscalReply> replies;
+    for (int i = 0; i < list.size(); i++)
+        replies.append(submit(list.at(i).toList()));
+
+    bool ok = true;
+    for (int i = 0; i < replies.size(); i++) {
+        const FiscalReply &reply = replies.at(i);
+        reply.waitForFinished();
+
+        QVariantMap line;
+        line["id"] = job["id"];
+        line["step"] = i;
+        line["ok"] = reply.isOk();
+        line["printer"] = reply.printerStatus();
+        line["fiscal"] = reply.fiscalStatus();
+        if (reply.value().isValid())
+            line["value"] = reply.value();
+        emit result(client, line);
+
+        ok = ok && reply.isOk();
+        const QString name = list.at(i).toList().value(0).toString();
+        if (name == "closeFiscalReceipt" || name == "closeDNFH")
+            done["number"] = reply.value();
+    }
+
+    done["ok"] = ok;
+    emit result(client, done);
+}
+
+FiscalReply SpoolerLane::submit(const QVariantList &command)
+{
+    const QString name = command.value(0).toString();
+    const QVariantList a = command.mid(1);
+
+    if (name == "statusRequest")
+        return fp->statusRequest(a.value(0).toInt());
+    if (name == "dailyClose")
+        return fp->dailyClose(toChar(a.value(0)));
+    if (name == "setCustomerData")
+        return fp->setCustomerData(a.value(0).toString(), a.value(1).toString(), toChar(a.value(2)),
+                a.value(3).toString(), a.value(4).toString());
+    if (name == "openFiscalReceipt")
+        return fp->openFiscalReceipt(toChar(a.value(0)));
+    if (name == "printFiscalText")
+        return fp->printFiscalText(a.value(0).toString());
+    if (name == "printLineItem")
+        return fp->printLineItem(a.value(0).toString(), a.value(1).toDouble(), a.value(2).toDouble(),
+                a.value(3).toString(), toChar(a.value(4)), a.value(5).toDouble());
+    if (name == "perceptions")
+        return fp->perceptions(a.value(0).toString(), a.value(1).toDouble());
+    if (name == "subtotal")
+        return fp->subtotal(toChar(a.value(0)));
+    if (name == "totalTender")
+        return fp->totalTender(a.value(0).toString(), a.value(1).toDouble(), toChar(a.value(2)));
+    if (name == "generalDiscount")
+        return fp->generalDiscount(a.value(0).toString(), a.value(1).toDouble(), a.value(2).toDouble(),
+                toChar(a.value(3)));
+    if (name == "closeFiscalReceipt")
+        return fp->closeFiscalReceipt(toChar(a.value(0)), toChar(a.value(1)), a.value(2).toInt());
+    if (name == "openNonFiscalReceipt")
+        return fp->openNonFiscalReceipt();
+    if (name == "printNonFiscalText")
+        return fp->printNonFiscalText(a.value(0).toString());
+    if (name == "closeNonFiscalReceipt")
+        return fp->closeNonFiscalReceipt();
+    if (name == "openDrawer")
+        return fp->openDrawer();
+    if (name == "setHeaderTrailer")
+        return fp->setHeaderTrailer(a.value(0).toString(), a.value(1).toString());
+    if (name == "setEmbarkNumber")
+        return fp->setEmbarkNumber(a.value(0).toInt(), a.value(1).toString(), toChar(a.value(2)));
+    if (name == "openDNFH")
+        return fp->openDNFH(toChar(a.value(0)), toChar(a.value(1)), a.value(2).toString());
+    if (name == "printEmbarkItem")
+        return fp->printEmbarkItem(a.value(0).toString(), a.value(1).toDouble());
+    if (name == "closeDNFH")
+        return fp->closeDNFH(a.value(0).toInt(), toChar(a.value(1)), a.value(2).toInt());
+    if (name == "cancel")
+        return fp->cancel();
+    if (name == "setDateTime")
+        return fp->setDateTime(QDateTime::currentDateTime());
+
+    return FiscalReply();
+}
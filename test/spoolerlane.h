@@ -0,0 +1,45 @@
+#ifndef SPOOLERLANE_H
+#define SPOOLERLANE_H
+
+#include <QThread>
+#include <QMutex>
+#include <QWaitCondition>
+#include <QQueue>
+#include <QPair>
+#include <QVariantMap>
+
+#include "../qfp/src/fiscalprinter.h"
+
+// Runs the jobs for one printer, one at a time and in arrival order, so the
+// commands of two clients never interleave in the same document.
+class SpoolerLane : public QThread
+{
+    Q_OBJECT
+
+public:
+    SpoolerLane(QObject *parent = 0, FiscalPrinter *fp = 0);
+
+    void enqueue(int client, const QVariantMap &job);
+    void stop();
+
+    static bool isKnown(const QString &command);
+
+signals:
+    // one line per command as its reply comes in, then one with "done"
+    void result(int client, const QVariantMap &line);
+
+protected:
+    void run();
+
+private:
+    void execute(int client, const QVariantMap &job);
+    FiscalReply submit(const QVariantList &command);
+
+    FiscalPrinter *fp;
+    QMutex m_mutex;
+    QWaitCondition m_queued;
+    QQueue<QPair<int, QVariantMap> > m_jobs;
+    bool m_continue;
+};
+
+#endif